@@ -0,0 +1,15 @@
+#pragma once
+#include <stddef.h>
+
+// The most bytes one scan can cover, so that positions fit in an unsigned
+// short. Lines are at most MAX_USER_INPUT, well within it.
+#define MAX_SCAN_SIZE 65535
+
+// Find every place in s where a word could end, the way the tokenizer
+// splits words: at a space (as isspace has it in the C locale) or a ';'.
+// Their indexes go in positions, in order, which needs room for len of
+// them, and the count is returned. This looks at 32 bytes at a time with
+// AVX2 when the CPU has it, 16 at a time with SSE2 on any other x86-64, and
+// one at a time elsewhere. It never reads past len, which must be at most
+// MAX_SCAN_SIZE.
+size_t scan_word_ends(const char *s, size_t len, unsigned short *positions);
@@ -3,25 +3,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "errors.h"
 #include "setup.h"
 
 #include "codememory.h"
+#include "scheduler.h"
+#include "shell.h"
 
 int allocate_frame_to_page(int pid, int page_num);
 int find_page_table_with_fname(int pid, char *fname);
 int get_pt_entry_for_line(int pid, int codeline);
-char *get_backstore_fname_for_pid(int pid);
 int load_page_at(int pid, int codeline);
+void release_frame(int frame_number);
 
-char **code_mem;
+char **code_mem; // each line points into the script its frame holds
+tokenized_line_t **code_mem_tokens; // each line of code_mem, tokenized when its script was read
+script_t **frame_scripts; // the script each frame holds lines of, which it has a reference to, or NULL
 char *free_frames;
 char *frame_access_timestamps;
 int curr_frame_timestamp = 0;
 
-page_table_t *page_table_array[MAX_NUM_PROCESSES] = {NULL};
+// Page tables, indexed by pid. Grows along with the process table, see reserve_page_table_for_pid.
+page_table_t **page_table_array = NULL;
+int page_table_array_capacity = 0;
 
 /**
 * Initializes the process code memory.
@@ -31,6 +38,8 @@ page_table_t *page_table_array[MAX_NUM_PROCESSES] = {NULL};
 int code_mem_init() {
     code_mem = malloc(CODE_MEM_SIZE * sizeof(char*));
     memset(code_mem, 0, CODE_MEM_SIZE * sizeof(char*));
+    code_mem_tokens = calloc(CODE_MEM_SIZE, sizeof(tokenized_line_t *));
+    frame_scripts = calloc(num_frames(), sizeof(script_t *));
 
     free_frames = (char *) malloc(num_frames() * sizeof(char));
     memset(free_frames, 1, num_frames() * sizeof(char));  // all frames initially free
@@ -48,12 +57,20 @@ int code_mem_init() {
 int code_mem_deinit() {
     free(code_mem);
     code_mem = NULL;
+    free(code_mem_tokens);
+    code_mem_tokens = NULL;
+    free(frame_scripts);
+    frame_scripts = NULL;
 
     free(free_frames);
     free_frames = NULL;
 
     free(frame_access_timestamps);
     frame_access_timestamps = NULL;
+
+    free(page_table_array);
+    page_table_array = NULL;
+    page_table_array_capacity = 0;
     return 0;
 }
 
@@ -66,17 +83,9 @@ int code_mem_deinit() {
 */
 int free_script_memory() {
     int error_code = 0;
-    char *pline;
-
-    for (int i = 0; i < CODE_MEM_SIZE; i++) {
-        pline = code_mem[i];
-        if (pline) {
-            free(pline);
-            code_mem[i] = NULL;
-        } 
-    }    
 
     for (int i = 0; i < num_frames(); i++) {
+        release_frame(i);
         free_frames[i] = 1; // free now
     }
 
@@ -94,7 +103,7 @@ int free_script_memory() {
 */
 int find_page_table_with_fname(int pid, char *fname) {
     page_table_t *pt;
-    for (int i = 0; i < MAX_NUM_PROCESSES; i++) {
+    for (int i = 0; i < page_table_array_capacity; i++) {
         pt = page_table_array[i];
         if (pt && strcmp(pt->backing_store_fname, fname) == 0 && i != pid) {
            return i;         
@@ -103,6 +112,33 @@ int find_page_table_with_fname(int pid, char *fname) {
     return pid;
 }
 
+/**
+* Makes sure page_table_array has a slot for pid, growing it if needed.
+*
+* @param pid the process ID
+* @return:
+*   - 0 when ok
+*   - error code when not ok
+*/
+int reserve_page_table_for_pid(int pid) {
+    if (pid < page_table_array_capacity) {
+        return 0;
+    }
+    int new_capacity = page_table_array_capacity ? page_table_array_capacity : INITIAL_NUM_PROCESSES;
+    while (new_capacity <= pid) {
+        new_capacity *= 2;
+    }
+    page_table_t **new_array = realloc(page_table_array, new_capacity * sizeof(page_table_t *));
+    if (!new_array) {
+        return badcommandOutOfPIDs();
+    }
+    memset(new_array + page_table_array_capacity, 0,
+           (new_capacity - page_table_array_capacity) * sizeof(page_table_t *));
+    page_table_array = new_array;
+    page_table_array_capacity = new_capacity;
+    return 0;
+}
+
 /**
 * Creates a page table for a process with a given backing store filename. If a page table already exists for the filename, it is reused.
 *
@@ -111,8 +147,13 @@ int find_page_table_with_fname(int pid, char *fname) {
 * @return:
 *   - 0 when ok
 *   - 1 when a page table already exists for the process
+*   - error code when the page table array can't grow
 */
 int create_page_table_for_pid(int pid, char *backing_store_fname) {
+    int error_code = reserve_page_table_for_pid(pid);
+    if (error_code) {
+        return error_code;
+    }
     if (page_table_array[pid]) {
         return 1;
     }
@@ -125,6 +166,7 @@ int create_page_table_for_pid(int pid, char *backing_store_fname) {
         size_t size_entries = MAX_PAGE_TABLE_ENTRIES * sizeof(int);
         curr_pt->entries = malloc(size_entries);
         memset(curr_pt->entries, -1, size_entries); // set all as invalid
+        curr_pt->script = NULL;
     } else {
         curr_pt = page_table_array[page_table_index];
     }
@@ -153,6 +195,10 @@ int free_page_table_for_pid(int pid) {
         pt->backing_store_fname = NULL;
         free(pt->entries);
         pt->entries = NULL;
+        if (pt->script) {
+            release_script(pt->script);
+            pt->script = NULL;
+        }
         free(pt);
     }
     return 0; 
@@ -167,7 +213,7 @@ int free_page_table_for_pid(int pid) {
 *   - the page table entry for the given process and code line
 */
 int get_pt_entry_for_line(int pid, int codeline){
-    if (!page_table_array[pid]) { // no PT for pid
+    if (pid >= page_table_array_capacity || !page_table_array[pid]) { // no PT for pid
         return -1;
     }
 
@@ -200,16 +246,37 @@ int allocate_frame_to_page(int pid, int page_num) {
 }
 
 /**
-* Returns the filename of the backing store for a process.
+* Returns the name of the script a process runs, or NULL if it has no page table.
 *
 * @param pid the process ID
-* @return:
-*   - the filename of the backing store for the process
 */
-char *get_backstore_fname_for_pid(int pid) {
+char *get_process_name(int pid) {
+    if (pid >= page_table_array_capacity || !page_table_array[pid]) {
+        return NULL;
+    }
     return page_table_array[pid]->backing_store_fname;
 }
 
+/**
+* Counts the pages of a process that are resident in a frame.
+*
+* @param pid the process ID
+* @return:
+*   - the number of resident pages, each of which holds one frame
+*/
+int count_resident_pages(int pid) {
+    int count = 0;
+    if (pid >= page_table_array_capacity || !page_table_array[pid]) {
+        return 0;
+    }
+    for (int i = 0; i < MAX_PAGE_TABLE_ENTRIES; i++) {
+        if (page_table_array[pid]->entries[i] != -1) {
+            count++;
+        }
+    }
+    return count;
+}
+
 /**
 * Loads a page at a given code line for a process.
 *
@@ -222,7 +289,6 @@ char *get_backstore_fname_for_pid(int pid) {
 int load_page_at(int pid, int codeline) {
     int error_code = 0;
     int memory_addr;
-    char line[MAX_USER_INPUT];
    
     // check if invalid entry
     int page_num = floor(codeline / PAGE_SIZE);
@@ -234,43 +300,39 @@ int load_page_at(int pid, int codeline) {
         frame_number = get_pt_entry_for_line(pid, codeline);
     }
 
-    char *filename = get_backstore_fname_for_pid(pid);
-    FILE *p = fopen(filename, "rt");
-    if (!p) {
+    script_t *script = page_table_array[pid]->script;
+    if (!script) {
         return badcommandFileDoesNotExist();
     }
 
-    // skip until codeline
-    for (int i = 0; i < codeline && fgets(line, MAX_USER_INPUT, p); i++) {
-       if (feof(p)) { break; }
-    }  
-    memset(line, 0, sizeof(line));
-
-    // load code into frame
+    // load code into frame, which only points at the lines of the script, already in memory and tokenized
+    release_frame(frame_number);
     for (int i = 0; i < PAGE_SIZE; i++) {
         memory_addr = (frame_number * PAGE_SIZE) + i;
         code_mem[memory_addr] = NULL;
-        if (fgets(line, MAX_USER_INPUT, p)) {
-            code_mem[memory_addr] = strdup(line);
-            memset(line, 0, sizeof(line));
+        code_mem_tokens[memory_addr] = NULL;
+        if (codeline + i < script->line_count) {
+            code_mem[memory_addr] = script->lines[codeline + i];
+            code_mem_tokens[memory_addr] = script->tokens[codeline + i];
         }
     }
-    fclose(p);
-    
+    script->refs++;
+    frame_scripts[frame_number] = script;
+
     return 0; 
 }
 
 /**
-* Returns the memory at a given code line for a process.
+* Returns the memory at a given code line for a process, as tokenized when its page was loaded.
 *
 * @param pid the process ID
 * @param codeline the code line
-* @param line a pointer to the line
+* @param line a pointer to the tokenized line
 * @return:
 *   - 0 when ok
 *   - 1 when page fault
 */
-int get_memory_at(int pid, int codeline, char **line) {
+int get_memory_at(int pid, int codeline, tokenized_line_t **line) {
     int error_code = 0;
     int memory_addr;
    
@@ -284,7 +346,7 @@ int get_memory_at(int pid, int codeline, char **line) {
     
     frame_access_timestamps[frame_number] = curr_frame_timestamp++; // update access time
     memory_addr = (frame_number * PAGE_SIZE) + offset;
-    *line = code_mem[memory_addr];
+    *line = code_mem_tokens[memory_addr];
     
     return error_code; 
 }
@@ -337,16 +399,15 @@ int evict_frame(int pid, int codeline) {
         if (code_mem[memory_addr]) {
             printf("%s", code_mem[memory_addr]);
         }
-        free(code_mem[memory_addr]);
-        code_mem[memory_addr] = NULL;
     }
+    release_frame(victim_frame_num);
 
     free_frames[victim_frame_num] = 1; // free for later call to load_page_at
 
     printf("\nEnd of victim page contents.\n");
 
     // update page tables to remove victim frame
-    for (int i = 0; i < MAX_NUM_PROCESSES; i++) {
+    for (int i = 0; i < page_table_array_capacity; i++) {
         if (page_table_array[i]) {
             page_table_t *pt = page_table_array[i];
             for (int j = 0; j < MAX_PAGE_TABLE_ENTRIES; j++) {
@@ -361,6 +422,22 @@ int evict_frame(int pid, int codeline) {
     return 0;
 }
 
+/**
+* Empties a frame, letting go of the script its lines belong to.
+*
+* @param frame_number the frame to empty
+*/
+void release_frame(int frame_number) {
+    for (int i = 0; i < PAGE_SIZE; i++) {
+        code_mem[frame_number * PAGE_SIZE + i] = NULL;
+        code_mem_tokens[frame_number * PAGE_SIZE + i] = NULL;
+    }
+    if (frame_scripts[frame_number]) {
+        release_script(frame_scripts[frame_number]);
+        frame_scripts[frame_number] = NULL;
+    }
+}
+
 /**
 * Loads the script contained in filename into process memory for a pid.
 *
@@ -373,10 +450,11 @@ int evict_frame(int pid, int codeline) {
 */
 int load_script_into_memory(int pid, int *line_count) {
     int error_code = 0;
-    char *filename = get_backstore_fname_for_pid(pid);
-    FILE *p = fopen(filename, "rt");
-    *line_count = count_lines_in_file(p);
-    fclose(p);
+    page_table_t *pt = page_table_array[pid];
+    if (!pt->script) { // processes running the same script share its page table, and so its lines
+        pt->script = open_script(pt->backing_store_fname);
+    }
+    *line_count = pt->script ? pt->script->line_count : 0;
     
     for (int i = 0; i < (*line_count < 2 * PAGE_SIZE ? *line_count : 2 * PAGE_SIZE); i += PAGE_SIZE) {
         load_page_at(pid, i);
@@ -403,6 +481,7 @@ int load_current_script_into_memory(int pid) {
         return exceptionCannotLoadInteractiveScript();
     }
 
+    release_batch_input(); // main() may have stdin mapped, rather than reading it through stdio
     int line_count = count_lines_in_file(stdin);
     
     for (int i = 0; i < line_count; i += 3) {
@@ -411,3 +490,161 @@ int load_current_script_into_memory(int pid) {
 
     return error_code;
 }
+
+// The script cache. Batch files run the same few scripts again and again, so once a script is read it stays in memory,
+// and the next process to run it gets its lines, already tokenized, for the price of a stat(). The file is taken to be
+// unchanged if it's the same inode on the same device, with the same size and modification time. The cache is a list
+// in LRU order, and only SCRIPT_CACHE_SIZE long, so it's searched from the front. It holds a reference to each script
+// in it, so a script that is evicted while processes still run it stays around until they're done.
+script_t *script_cache = NULL;
+int script_cache_count = 0;
+
+/**
+* Reads a script from a file, tokenizing every line.
+*
+* @param p the file, which is read from the start
+* @return:
+*   - the script, with one reference, for the caller
+*/
+script_t *read_script(FILE *p) {
+    script_t *script = calloc(1, sizeof(script_t));
+    long *offsets;
+    script->refs = 1;
+    script->line_count = index_lines_in_file(p, &offsets);
+    script->lines = malloc(script->line_count * sizeof(char *));
+    script->tokens = malloc(script->line_count * sizeof(tokenized_line_t *));
+    script->text = malloc(offsets[script->line_count] + script->line_count + 1);
+
+    // the line index says where each line is, so each is read into place in one go, and given its NUL
+    char *next_line = script->text;
+    rewind(p);
+    for (int i = 0; i < script->line_count; i++) {
+        size_t n = fread(next_line, 1, offsets[i + 1] - offsets[i], p);
+        next_line[n] = '\0';
+        script->lines[i] = next_line;
+        script->tokens[i] = tokenize_line(next_line, strnlen(next_line, n));
+        next_line += n + 1;
+    }
+    free(offsets);
+    return script;
+}
+
+/**
+* Gives up a reference to a script, freeing it if that was the last one.
+*
+* @param script the script
+*/
+void release_script(script_t *script) {
+    if (--script->refs > 0) {
+        return;
+    }
+    for (int i = 0; i < script->line_count; i++) {
+        free(script->tokens[i]);
+    }
+    free(script->tokens);
+    free(script->lines);
+    free(script->text);
+    free(script);
+}
+
+/**
+* Takes a script out of the cache list.
+*
+* @param script the script, which is in the cache
+*/
+void unlink_cached_script(script_t *script) {
+    if (script->prev) {
+        script->prev->next = script->next;
+    } else {
+        script_cache = script->next;
+    }
+    if (script->next) {
+        script->next->prev = script->prev;
+    }
+    script->prev = script->next = NULL;
+}
+
+/**
+* Puts a script at the front of the cache list, as the most recently used.
+*
+* @param script the script, which isn't in the cache list
+*/
+void push_cached_script(script_t *script) {
+    script->next = script_cache;
+    if (script_cache) {
+        script_cache->prev = script;
+    }
+    script_cache = script;
+}
+
+/**
+* Removes a script from the cache, and lets go of the cache's reference to it.
+*
+* @param script the script, which is in the cache
+*/
+void evict_cached_script(script_t *script) {
+    unlink_cached_script(script);
+    script_cache_count--;
+    release_script(script);
+}
+
+/**
+* Returns the script in a file, from the script cache if the file hasn't changed since it was read, or reading it
+* (and caching it, if it's a regular file) otherwise.
+*
+* @param fname the file name
+* @return:
+*   - the script, with a reference for the caller
+*   - NULL if the file can't be opened
+*/
+script_t *open_script(char *fname) {
+    struct stat st;
+    script_t *script;
+
+    if (stat(fname, &st) == 0 && S_ISREG(st.st_mode)) {
+        for (script = script_cache; script; script = script->next) {
+            if (script->dev == st.st_dev && script->ino == st.st_ino && script->size == st.st_size
+                && script->mtime.tv_sec == st.st_mtim.tv_sec && script->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                unlink_cached_script(script);
+                push_cached_script(script);
+                script->refs++;
+                return script;
+            }
+        }
+    }
+
+    FILE *p = fopen(fname, "rt");
+    if (!p) {
+        return NULL;
+    }
+    // the script is keyed by the file as it is now, in case it changed since the stat() above
+    int cacheable = fstat(fileno(p), &st) == 0 && S_ISREG(st.st_mode);
+    script = read_script(p);
+    fclose(p);
+    if (!cacheable) {
+        return script;
+    }
+
+    // the file's old contents, if they're cached, will never be wanted again
+    for (script_t *old = script_cache; old; old = old->next) {
+        if (old->dev == st.st_dev && old->ino == st.st_ino) {
+            evict_cached_script(old);
+            break;
+        }
+    }
+    if (script_cache_count == SCRIPT_CACHE_SIZE) {
+        script_t *lru = script_cache;
+        while (lru->next) {
+            lru = lru->next;
+        }
+        evict_cached_script(lru);
+    }
+    script->dev = st.st_dev;
+    script->ino = st.st_ino;
+    script->size = st.st_size;
+    script->mtime = st.st_mtim;
+    script->refs++;
+    push_cached_script(script);
+    script_cache_count++;
+    return script;
+}
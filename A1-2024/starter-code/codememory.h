@@ -1,11 +1,35 @@
 #ifndef CODEMEMORY_H
 #define CODEMEMORY_H
 
+#include <sys/types.h>
+#include <time.h>
+
+#include "scheduler.h"
 #include "setup.h"
 
+#define SCRIPT_CACHE_SIZE 16 // how many scripts stay in memory, once read, for the next process that runs them
+
+// A script file, read into memory once: its lines, split the way fgets would split them, and each line tokenized.
+// Frames point at these lines rather than copying them, so a script is shared by page tables, frames and the script
+// cache, and freed when none of them need it any more.
+typedef struct script {
+    int refs;
+    int line_count;
+    char **lines;
+    tokenized_line_t **tokens;
+    char *text; // every line, NUL-terminated, one after the other
+    // the file, as it was when it was read; the cache only reuses the script if the file still looks the same
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct script *prev, *next; // the script cache, most recently used first
+} script_t;
+
 typedef struct {
     char *backing_store_fname;
     int *entries;
+    script_t *script; // the backing store's contents; NULL until the script is loaded, or if it can't be read
 } page_table_t;
 
 int code_mem_init();
@@ -14,10 +38,14 @@ int free_script_memory();
 int create_page_table_for_pid(int pid, char *backing_store_fname);
 int free_page_table_for_pid(int pid);
 int load_page_at(int pid, int codeline);
-int get_memory_at(int pid, int codeline, char **line);
+int get_memory_at(int pid, int codeline, tokenized_line_t **line);
 int handle_page_fault(int pid, int codeline);
 int evict_frame(int pid, int codeline);
 int load_script_into_memory(int pid, int *line_count);
 int load_current_script_into_memory(int pid);
+char *get_process_name(int pid);
+int count_resident_pages(int pid);
+script_t *open_script(char *fname);
+void release_script(script_t *script);
 
 #endif
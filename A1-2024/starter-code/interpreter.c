@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> 
@@ -7,6 +8,7 @@
 
 #include "codememory.h"
 #include "errors.h"
+#include "interpreter.h"
 #include "resourcemanager.h"
 #include "scheduler.h"
 #include "schedulermemory.h"
@@ -27,6 +29,8 @@ int my_touch(char* filename);
 int my_mkdir(char* dirname);
 int my_cd(char* dirname);
 int exec(char *command_args[], int num_args);
+int ps();
+int top();
 int create_process_from_filename(char *filename, int *ppid);
 int create_process_from_current_file(int *ppid);
 void *run_multithreaded_scheduler(void *arg);
@@ -37,6 +41,96 @@ char awaits_quit = 0;
 void set_awaits_quit(char val);
 char get_awaits_quit();
 
+/**
+* Handlers for the builtins table. Each takes the whole command, its name included, so that they can all be called the
+* same way; the table has already checked that there are as many arguments as the builtin needs.
+*/
+int run_help(char *command_args[], int args_size) { return help(); }
+int run_quit(char *command_args[], int args_size) { return quit(); }
+int run_set(char *command_args[], int args_size) { return set(command_args, args_size); }
+int run_print(char *command_args[], int args_size) { return print(command_args[1]); }
+int run_run(char *command_args[], int args_size) { return run(command_args[1]); }
+int run_echo(char *command_args[], int args_size) { return echo(command_args[1]); }
+int run_my_ls(char *command_args[], int args_size) { return my_ls(); }
+int run_my_touch(char *command_args[], int args_size) { return my_touch(command_args[1]); }
+int run_my_mkdir(char *command_args[], int args_size) { return my_mkdir(command_args[1]); }
+int run_my_cd(char *command_args[], int args_size) { return my_cd(command_args[1]); }
+int run_exec(char *command_args[], int args_size) { return exec(command_args, args_size); }
+int run_ps(char *command_args[], int args_size) { return ps(); }
+int run_top(char *command_args[], int args_size) { return top(); }
+
+// Every builtin: its command, its name, the first and last characters of its name (spelled out so that its slot in
+// command_slots is a constant), how many words it takes counting its name, and its handler.
+#define BUILTINS(X) \
+    X(CMD_HELP,     "help",     'h', 'p', 1, 1,       run_help) \
+    X(CMD_QUIT,     "quit",     'q', 't', 1, 1,       run_quit) \
+    X(CMD_SET,      "set",      's', 't', 3, 7,       run_set) \
+    X(CMD_PRINT,    "print",    'p', 't', 2, 2,       run_print) \
+    X(CMD_RUN,      "run",      'r', 'n', 2, 2,       run_run) \
+    X(CMD_ECHO,     "echo",     'e', 'o', 2, 2,       run_echo) \
+    X(CMD_MY_LS,    "my_ls",    'm', 's', 1, 1,       run_my_ls) \
+    X(CMD_MY_TOUCH, "my_touch", 'm', 'h', 2, 2,       run_my_touch) \
+    X(CMD_MY_MKDIR, "my_mkdir", 'm', 'r', 2, 2,       run_my_mkdir) \
+    X(CMD_MY_CD,    "my_cd",    'm', 'd', 2, 2,       run_my_cd) \
+    X(CMD_EXEC,     "exec",     'e', 'c', 3, INT_MAX, run_exec) /* exec takes any number of scripts */ \
+    X(CMD_PS,       "ps",       'p', 's', 1, 1,       run_ps) \
+    X(CMD_TOP,      "top",      't', 'p', 1, 1,       run_top)
+
+typedef struct {
+    const char *name;
+    int name_len;
+    int min_args;
+    int max_args;
+    int (*run)(char *command_args[], int args_size);
+} builtin_t;
+
+// Indexed by command_t. CMD_UNKNOWN has no handler, so it is always a bad command.
+const builtin_t builtins[CMD_UNKNOWN + 1] = {
+#define BUILTIN(command, name, first, last, min_args, max_args, run) \
+    [command] = { name, sizeof(name) - 1, min_args, max_args, run },
+    BUILTINS(BUILTIN)
+#undef BUILTIN
+};
+
+// Names are looked up in a perfect hash table: a name's slot depends only on its first and last characters, and no
+// two builtins share one, so a lookup compares the name against the only builtin it could be, however many builtins
+// there are. The multipliers were found by trying small ones until no builtins collided.
+#define COMMAND_SLOTS 32
+#define COMMAND_HASH(first, last) (((unsigned char) (first) + 2u * (unsigned char) (last)) % COMMAND_SLOTS)
+
+const builtin_t *command_slots[COMMAND_SLOTS] = {
+#define SLOT(command, name, first, last, min_args, max_args, run) [COMMAND_HASH(first, last)] = &builtins[command],
+    BUILTINS(SLOT)
+#undef SLOT
+};
+
+// Had two builtins the same slot, one would replace the other in command_slots. With a bit per slot, the sum of the
+// builtins' bits only equals their OR if no two share a bit.
+#define SLOT_BIT_OR(command, name, first, last, min_args, max_args, run) | (1ull << COMMAND_HASH(first, last))
+#define SLOT_BIT_SUM(command, name, first, last, min_args, max_args, run) + (1ull << COMMAND_HASH(first, last))
+_Static_assert((0 BUILTINS(SLOT_BIT_OR)) == (0 BUILTINS(SLOT_BIT_SUM)),
+               "two builtins hash to the same slot; pick a new COMMAND_HASH");
+
+/**
+* Looks up the builtin with a given name.
+*
+* @param name: the first word of a command, which ends at a newline like every argument
+* @return:
+*   - the builtin
+*   - CMD_UNKNOWN if there is no builtin with that name
+*/
+command_t command_named(char *name) {
+    size_t len = strcspn(name, "\r\n");
+    if (len == 0) {
+        return CMD_UNKNOWN;
+    }
+    const builtin_t *builtin = command_slots[COMMAND_HASH(name[0], name[len - 1])];
+    if (builtin && builtin->name_len == len && memcmp(builtin->name, name, len) == 0) {
+        return builtin - builtins;
+    }
+    return CMD_UNKNOWN;
+}
+
 /**
 * Interprets the command and their arguments.
 * @param:
@@ -47,11 +141,27 @@ char get_awaits_quit();
 *   - error code when not ok 
 */
 int interpreter(char* command_args[], int args_size) {
+    command_t command = args_size < 1 ? CMD_UNKNOWN : command_named(command_args[0]);
+    return run_command(command, command_args, args_size);
+}
+
+/**
+* Runs a builtin that was already looked up, as for the lines of a script, which are tokenized when their page is loaded.
+* @param:
+*   - command: the builtin named by command_args[0]
+*   - command_args: an array of the command and its arguments
+*   - args_size: the number of arguments in command_args
+* @return:
+*   - 0 if success
+*   - error code when not ok 
+*/
+int run_command(command_t command, char *command_args[], int args_size) {
+    const builtin_t *builtin = &builtins[command];
     int i;
 
     if (args_size < 1) {
         return badcommand();
-    } else if (args_size > MAX_ARGS_SIZE) {
+    } else if (args_size > MAX_ARGS_SIZE && builtin->max_args <= MAX_ARGS_SIZE) {
         return badcommandTooManyTokens();
     }
 
@@ -59,55 +169,10 @@ int interpreter(char* command_args[], int args_size) {
         command_args[i][strcspn(command_args[i], "\r\n")] = 0;
     }
 
-    if (strcmp(command_args[0], "help") == 0){
-        if (args_size != 1) return badcommand();
-        return help();
-    
-    } else if (strcmp(command_args[0], "quit") == 0) {
-        if (args_size != 1) return badcommand();
-        return quit();
-
-    } else if (strcmp(command_args[0], "set") == 0) {
-        //set
-        if (args_size < 3) return badcommand();
-        else if (args_size > 7) return badcommandTooManyTokens();
-        return set(command_args, args_size);
-    
-    } else if (strcmp(command_args[0], "print") == 0) {
-        if (args_size != 2) return badcommand();
-        return print(command_args[1]);
-    
-    } else if (strcmp(command_args[0], "run") == 0) {
-        if (args_size != 2) return badcommand();
-        return run(command_args[1]);
-    
-    } else if (strcmp(command_args[0], "echo") == 0) {
-        if (args_size != 2) return badcommand();
-        return echo(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_ls") == 0) {
-        if (args_size != 1) return badcommand();
-        return my_ls();
-
-    } else if (strcmp(command_args[0], "my_touch") == 0) {
-        if (args_size != 2) return badcommand();
-        return my_touch(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_mkdir") == 0) {
-        if (args_size != 2) return badcommand();
-        return my_mkdir(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_cd") == 0) {
-        if (args_size != 2) return badcommand();
-        return my_cd(command_args[1]);
-
-    } else if (strcmp(command_args[0], "exec") == 0) {
-        if (args_size < 3) return badcommand();
-        else if (args_size > 7) return badcommandTooManyTokens();
-        return exec(command_args, args_size);
-    } 
-    
-    else return badcommand();
+    if (!builtin->run || args_size < builtin->min_args || args_size > builtin->max_args) {
+        return badcommand();
+    }
+    return builtin->run(command_args, args_size);
 }
 
 /**
@@ -185,13 +250,12 @@ int set(char *command_args[], int num_args) {
 *   - error code when not ok
 */
 int print(char *var) {
-    char *value = mem_get_value(var);
+    const char *value = mem_view_value(var);
     if (value) {
         printf("%s\n", value);
     } else {
         printf("Variable does not exist\n");
     }
-    free(value);
     return 0;
 }
 
@@ -230,19 +294,12 @@ int echo(char *arg) {
     if (arg[0] == '\0') {
         return badcommandTooFewTokens();
     } else if (arg[0] == '$') {
-        size_t sizeof_var = sizeof(char) * strlen(arg);
-        char *var = malloc(sizeof_var);
-        memset(var, '\0', sizeof_var);
-        strcpy(var, (arg + 1)); // skip the '$' char
-
-        char *value = mem_get_value(var);
+        const char *value = mem_view_value(arg + 1); // skip the '$' char
         if (value) {
             printf("%s\n", value);
         } else {
             printf("\n");
         }
-        free(value);
-        free(var);
 
     } else {
         printf("%s\n", arg);
@@ -309,12 +366,7 @@ int my_mkdir(char *dirname) {
     if (dirname[0] == '\0') {
         return badcommandTooFewTokens();
     } else if (dirname[0] == '$') {
-        size_t sizeof_var = sizeof(char) * strlen(dirname);
-        char *var = malloc(sizeof_var);
-        memset(var, '\0', sizeof_var);
-        strcpy(var, (dirname + 1)); // skip the '$' char
-
-        char *value = mem_get_value(var);
+        const char *value = mem_view_value(dirname + 1); // skip the '$' char
         if (value && strchr(value, ' ') == NULL) {
             res = mkdir(value, 0777);
         } else {
@@ -353,6 +405,29 @@ int my_cd(char *dirname) {
     return 0;
 }
 
+/**
+* Shows the accounting of every process: instructions, quanta, context switches,
+* page faults, time spent ready, turnaround and resident frames.
+*
+* @return:
+*   - 0
+*/
+int ps() {
+    print_process_table();
+    return 0;
+}
+
+/**
+* Like ps, but keeps refreshing while the scheduler runs.
+*
+* @return:
+*   - 0
+*/
+int top() {
+    start_top();
+    return 0;
+}
+
 /**
 * Executes the scripts passed according to a policy. Can be run in the background, or multithreaded.
 * 
@@ -381,11 +456,7 @@ int exec(char *command_args[], int num_args) {
 
     policy = command_args[policy_index];
 
-    if (strcmp(policy, "FCFS") != 0 &&
-        strcmp(policy, "SJF") != 0 &&
-        strcmp(policy, "RR") != 0 &&
-        strcmp(policy, "RR30") != 0 &&
-        strcmp(policy, "AGING") != 0) {
+    if (!is_valid_policy(policy)) {
         return badcommandInvalidPolicy();
     }
 
@@ -1,2 +1,27 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+// The builtins, so that a command can be looked up once and dispatched by number.
+typedef enum {
+    CMD_HELP,
+    CMD_QUIT,
+    CMD_SET,
+    CMD_PRINT,
+    CMD_RUN,
+    CMD_ECHO,
+    CMD_MY_LS,
+    CMD_MY_TOUCH,
+    CMD_MY_MKDIR,
+    CMD_MY_CD,
+    CMD_EXEC,
+    CMD_PS,
+    CMD_TOP,
+    CMD_UNKNOWN
+} command_t;
+
+command_t command_named(char *name);
 int interpreter(char *command_args[], int args_size);
+int run_command(command_t command, char *command_args[], int args_size);
 int help();
+
+#endif
@@ -0,0 +1,117 @@
+#include "scan.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+// Each kernel writes the index of every byte of s that is a, b or c to positions, in order, and returns how many
+// there are. Looking for fewer bytes just repeats one of them. The vector kernels compare a whole block of bytes at
+// once, turn the result into a bit mask, and then take the set bits out of it lowest first.
+
+/**
+* Finds every one of three bytes a byte at a time.
+*
+* @param s the bytes to scan
+* @param len how many there are
+* @param a, b, c the bytes to look for
+* @param positions gets where they are
+* @param start what to add to each position
+* @return:
+*   - how many were found
+*/
+static inline size_t scan_scalar(const char *s, size_t len, char a, char b, char c,
+                                 unsigned short *positions, size_t start) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == a || s[i] == b || s[i] == c) {
+            positions[count++] = start + i;
+        }
+    }
+    return count;
+}
+
+#ifdef SCAN_X86
+/**
+* Finds every one of three bytes 16 bytes at a time. SSE2 is part of x86-64, so this always works there.
+*/
+static inline size_t scan_sse2(const char *s, size_t len, char a, char b, char c, unsigned short *positions) {
+    __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+        for (unsigned mask = _mm_movemask_epi8(hits); mask; mask &= mask - 1) {
+            positions[count++] = i + __builtin_ctz(mask);
+        }
+    }
+    return count + scan_scalar(s + i, len - i, a, b, c, positions + count, i);
+}
+
+/**
+* Finds every one of three bytes 32 bytes at a time. Only call this if the CPU has AVX2.
+*/
+__attribute__((target("avx2")))
+static inline size_t scan_avx2(const char *s, size_t len, char a, char b, char c, unsigned short *positions) {
+    __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (s + i));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+                                       _mm256_cmpeq_epi8(v, vc));
+        for (unsigned mask = _mm256_movemask_epi8(hits); mask; mask &= mask - 1) {
+            positions[count++] = i + __builtin_ctz(mask);
+        }
+    }
+    return count + scan_scalar(s + i, len - i, a, b, c, positions + count, i);
+}
+
+/**
+* Checks for AVX2. The CPU is identified once, by libgcc at startup, so this is only a load and a test.
+*/
+static inline int has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+/**
+* Finds where every word of a line could end, the way the tokenizer splits words: at a space, ';' or newline.
+*
+* @param s the line
+* @param len its length
+* @param positions gets where each of those characters is; it needs room for len of them
+* @return:
+*   - how many there are
+*/
+size_t scan_word_ends(const char *s, size_t len, unsigned short *positions) {
+#ifdef SCAN_X86
+    if (has_avx2()) {
+        return scan_avx2(s, len, ' ', ';', '\n', positions);
+    }
+    return scan_sse2(s, len, ' ', ';', '\n', positions);
+#else
+    return scan_scalar(s, len, ' ', ';', '\n', positions, 0);
+#endif
+}
+
+/**
+* Finds every newline.
+*
+* @param s the bytes to scan
+* @param len how many there are
+* @param positions gets where each newline is; it needs room for len of them
+* @return:
+*   - how many there are
+*/
+size_t scan_newlines(const char *s, size_t len, unsigned short *positions) {
+#ifdef SCAN_X86
+    if (has_avx2()) {
+        return scan_avx2(s, len, '\n', '\n', '\n', positions);
+    }
+    return scan_sse2(s, len, '\n', '\n', '\n', positions);
+#else
+    return scan_scalar(s, len, '\n', '\n', '\n', positions, 0);
+#endif
+}
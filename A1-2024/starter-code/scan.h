@@ -0,0 +1,15 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+#define MAX_SCAN_SIZE 65535 // the most bytes one scan can cover, so that positions fit in an unsigned short
+
+// Scanning kernels for the tokenizer and the line index. Each finds every position of some bytes in one pass, looking
+// at 32 bytes at a time with AVX2 when the CPU has it, 16 at a time with SSE2 on any other x86-64, and one at a time
+// elsewhere. They never read past len, which must be at most MAX_SCAN_SIZE.
+
+size_t scan_word_ends(const char *s, size_t len, unsigned short *positions);
+size_t scan_newlines(const char *s, size_t len, unsigned short *positions);
+
+#endif
@@ -1,3 +1,5 @@
+#include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -5,8 +7,10 @@
 #include "codememory.h"
 #include "errors.h"
 #include "interpreter.h"
+#include "scan.h"
 #include "schedulermemory.h"
 #include "setup.h"
+#include "trace.h"
 
 #include "scheduler.h"
 
@@ -19,46 +23,168 @@
 *   - error code when not ok
 */
 int parseInput(char inp[]) {
-    char tmp[200];
-    char *words[100];
+    return parse_line(inp, strnlen(inp, MAX_USER_INPUT)); // the line ends at its NUL, or after MAX_USER_INPUT characters
+}
+
+/**
+* Parses a line that needn't end in a NUL into words and interprets them.
+*
+* @param inp the line to parse
+* @param len how many characters of it there are
+* @return:
+*   - 0 if success
+*   - error code when not ok
+*/
+int parse_line(const char *inp, int len) {
+    tokenized_line_t *line = tokenize_line(inp, len);
+    int errorCode = run_tokenized_line(line);
+    free(line);
+    return errorCode;
+}
+
+/**
+* Splits a line into words, and its chain into commands, looking up the builtin each command names.
+* Script lines are tokenized once, when their script is read (see read_script), rather than every time they run.
+*
+* @param inp the line to tokenize
+* @param len how many characters of it there are, at most MAX_USER_INPUT; it needn't end in a NUL
+* @return:
+*   - the tokenized line, in a single allocation to free() when done
+*/
+tokenized_line_t *tokenize_line(const char *inp, int len) {
+    // Every word takes at least the character that ends it, so they fit in as much room as the line itself.
+    char text[MAX_USER_INPUT + 1];
+    int word_offsets[MAX_USER_INPUT + 1];
+    int first_words[MAX_USER_INPUT + 1]; // the index of the first word of each command, then the number of words
+    int num_words = 0;
+    int num_instructions = 0;
+    int text_size = 0;
+    unsigned short word_ends[MAX_USER_INPUT + 1]; // where a word could end, in order, then the end of the line
+    int num_word_ends = scan_word_ends(inp, len, word_ends);
+    int next_word_end = 0;
     int ix = 0;
-    int w = 0;
-    int wordlen = 0;
-    int errorCode = 0;
-    for (; inp[ix] == ' ' && ix < 1000; ix++); // skip white spaces
-    while (inp[ix] != '\n' && inp[ix] != '\0' && ix < 1000) {
-        // extract a word
-        for (wordlen = 0; !wordEnding(inp[ix]) && ix < 1000; ix++, wordlen++) {
-            tmp[wordlen] = inp[ix];                        
-        }
-        tmp[wordlen] = '\0';
-        words[w] = strdup(tmp);
-        w++;
-        if (inp[ix] == '\0') break;
-        else if (inp[ix] == ';') { // process chained command
-            errorCode = interpreter(words, w) || errorCode; // if chaining and a command fails, keep that error code
-
-            for (int i = 0; i < w; i++) {
-                free(words[i]);
-                words[i] = 0;
-            }
-            w = 0;
+
+    word_ends[num_word_ends] = len;
+
+    first_words[num_instructions] = 0;
+    for (; ix < len && inp[ix] == ' '; ix++); // skip white spaces
+    while (ix < len && inp[ix] != '\n') {
+        // extract a word, which ends at the next space, ';' or newline
+        int start = ix;
+        for (; word_ends[next_word_end] < ix; next_word_end++);
+        ix = word_ends[next_word_end];
+        word_offsets[num_words++] = text_size;
+        memcpy(text + text_size, inp + start, ix - start);
+        text_size += ix - start;
+        text[text_size++] = '\0';
+
+        if (ix == len) break;
+        else if (inp[ix] == ';') { // start the next command of the chain
+            first_words[++num_instructions] = num_words;
             ix++; // skip over ';' character
+            if (ix == len) break; // the character after it is skipped too, but not the end of the line
         }
 
         ix++;
     }
+    first_words[++num_instructions] = num_words;
+
+    // The instructions, then the words, then the text.
+    size_t instructions_size = num_instructions * sizeof(instruction_t);
+    size_t argv_size = num_words * sizeof(char *);
+    tokenized_line_t *line = malloc(sizeof(tokenized_line_t) + instructions_size + argv_size + text_size);
+    line->num_instructions = num_instructions;
+    line->instructions = (instruction_t *) (line + 1);
+    char **argv = (char **) ((char *) line->instructions + instructions_size);
+    line->text = (char *) argv + argv_size;
+    line->text_size = text_size;
+    memcpy(line->text, text, text_size);
+
+    for (int w = 0; w < num_words; w++) {
+        argv[w] = line->text + word_offsets[w];
+    }
+    for (int i = 0; i < num_instructions; i++) {
+        instruction_t *instruction = &line->instructions[i];
+        instruction->argc = first_words[i + 1] - first_words[i];
+        instruction->argv = argv + first_words[i];
+        instruction->command = instruction->argc ? command_named(instruction->argv[0]) : CMD_UNKNOWN;
+    }
+    return line;
+}
 
-    // process last command 
-    errorCode = interpreter(words, w) || errorCode;
+/**
+* Runs every command of a tokenized line.
+*
+* @param line the line to run, which is left as it was, so that it can be run again
+* @return:
+*   - 0 if success
+*   - error code when not ok
+*/
+int run_tokenized_line(tokenized_line_t *line) {
+    // the commands are allowed to change their words, so they get a copy
+    char text[MAX_USER_INPUT + 1];
+    char *words[MAX_USER_INPUT + 1];
+    int errorCode = 0;
+    memcpy(text, line->text, line->text_size);
 
-    for (int i = 0; i < w; i++) {
-        free(words[i]);
-        words[i] = 0;
+    for (int i = 0; i < line->num_instructions; i++) {
+        instruction_t *instruction = &line->instructions[i];
+        for (int w = 0; w < instruction->argc; w++) {
+            words[w] = text + (instruction->argv[w] - line->text);
+        }
+        errorCode = run_command(instruction->command, words, instruction->argc) || errorCode; // if chaining and a command fails, keep that error code
     }
     return errorCode;
 }
 
+/**
+* Parses the time slice out of a round robin policy name.
+* "RR" has a time slice of 2 instructions, and "RR<n>" (e.g. "RR30") has a time slice of n.
+*
+* @param policy: the policy name
+* @param pquantum: a pointer to the time slice. Gets updated when the name is valid.
+* @return:
+*   - 0 if policy is a valid round robin policy
+*   - 1 otherwise
+*/
+int parse_round_robin_quantum(char *policy, int *pquantum) {
+    char *end;
+
+    if (strncmp(policy, "RR", 2) != 0) {
+        return 1;
+    }
+    if (policy[2] == '\0') {
+        *pquantum = 2;
+        return 0;
+    }
+    if (!isdigit((unsigned char) policy[2])) {
+        return 1;
+    }
+
+    long quantum = strtol(policy + 2, &end, 10);
+    if (*end != '\0' || quantum <= 0 || quantum > INT_MAX) {
+        return 1;
+    }
+    *pquantum = (int) quantum;
+    return 0;
+}
+
+/**
+* Checks whether policy names a scheduling policy that run_scheduler supports.
+*
+* @param policy: the policy name
+* @return:
+*   - 1 if the policy is valid
+*   - 0 otherwise
+*/
+int is_valid_policy(char *policy) {
+    int quantum;
+    return strcmp(policy, "FCFS") == 0 ||
+        strcmp(policy, "SJF") == 0 ||
+        strcmp(policy, "AGING") == 0 ||
+        parse_round_robin_quantum(policy, &quantum) == 0;
+}
+
 /**
 * Runs the scheduler for a policy.
 * 
@@ -69,6 +195,7 @@ int parseInput(char inp[]) {
 */
 int run_scheduler(char *policy) {
     int error_code = 0;
+    int quantum;
     
     if (is_process_running()) {
         return error_code;
@@ -81,12 +208,9 @@ int run_scheduler(char *policy) {
         ready_queue_reorder_sjf(policy);
         error_code = sequential_policy();
 
-    } else if (strcmp(policy, "RR") == 0) {
-        error_code = round_robin_policy(2);
+    } else if (parse_round_robin_quantum(policy, &quantum) == 0) {
+        error_code = round_robin_policy(quantum);
 
-    } else if (strcmp(policy, "RR30") == 0) {
-        error_code = round_robin_policy(30);
-    
     } else if (strcmp(policy, "AGING") == 0) {
         error_code = aging_policy();
 
@@ -95,10 +219,21 @@ int run_scheduler(char *policy) {
     }
 
     set_process_not_running();
+    stop_top();
     free_script_memory();
     return error_code;
 }
 
+/**
+* Records the dispatch of a process in the trace, labelled with its script.
+*
+* @param pid the process ID
+*/
+void trace_dispatch(int pid) {
+    char *name = get_process_name(pid);
+    trace_event(TRACE_DISPATCH, pid, name ? name : "(shell)");
+}
+
 /**
 * Sequentially runs each job until completion in the order they were loaded in the ready queue.
 *
@@ -109,7 +244,7 @@ int run_scheduler(char *policy) {
 *   - 1 if error
 */
 int sequential_policy() {
-    char *line;
+    tokenized_line_t *line;
     pcb_t *curr_pcb;
     int curr_pid = 0;
     int error_code = 0;
@@ -122,17 +257,22 @@ int sequential_policy() {
         if (get_pcb_for_pid(curr_pid, &curr_pcb)) {
             return 1; // TODO better error: no such pcb
         }
+        account_slice_start(curr_pcb);
+        trace_dispatch(curr_pid);
 
         while (curr_pcb->code_offset < curr_pcb->job_length_score) {
             if (!get_memory_at(curr_pid, curr_pcb->code_offset, &line) && line) {
-                error_code = parseInput(line);
+                error_code = run_tokenized_line(line);
                 curr_pcb->code_offset++;
             } else {
+                curr_pcb->page_faults++;
+                trace_event(TRACE_PAGE_FAULT, curr_pid, NULL);
                 handle_page_fault(curr_pid, curr_pcb->code_offset);
             }
         }
         
         // Job is done, free up resources
+        trace_event(TRACE_EXIT, curr_pid, NULL);
         free_pcb_for_pid(curr_pid);
         free_page_table_for_pid(curr_pid);
     }
@@ -141,7 +281,7 @@ int sequential_policy() {
 }
 
 /**
-* Runs each job for a time slice of 2 instructions.
+* Runs each job for a time slice of max_timer instructions.
 *
 * If a job is not completed in the time slice, it is pushed back in the back of the ready queue.
 * @return:
@@ -149,7 +289,7 @@ int sequential_policy() {
 *   - 1 if error
 */
 int round_robin_policy(int max_timer) {
-    char *line;
+    tokenized_line_t *line;
     pcb_t *curr_pcb;
     int curr_pid = 0;
     int error_code = 0;
@@ -164,22 +304,29 @@ int round_robin_policy(int max_timer) {
             return 1; // TODO better error: no such pcb
         }
         timer = max_timer;
+        account_slice_start(curr_pcb);
+        trace_dispatch(curr_pid);
 
         while (timer > 0 && curr_pcb->code_offset < curr_pcb->job_length_score) {
             if (!get_memory_at(curr_pid, curr_pcb->code_offset, &line) && line) {
-                error_code = parseInput(line);
+                error_code = run_tokenized_line(line);
                 curr_pcb->code_offset++;
                 timer--;
             } else {
+                curr_pcb->page_faults++;
+                trace_event(TRACE_PAGE_FAULT, curr_pid, NULL);
                 handle_page_fault(curr_pid, curr_pcb->code_offset);
                 break;
             }
         }
 
         if (curr_pcb->code_offset >= curr_pcb->job_length_score) {
+            trace_event(TRACE_EXIT, curr_pid, NULL);
             free_pcb_for_pid(curr_pid);
             free_page_table_for_pid(curr_pid);
         } else {
+            trace_event(TRACE_PREEMPT, curr_pid, NULL);
+            account_slice_end(curr_pcb);
             ready_queue_push(curr_pid);
         }
     }
@@ -198,7 +345,7 @@ int round_robin_policy(int max_timer) {
 *   - 1 if error
 */
 int aging_policy() {
-    char *line;
+    tokenized_line_t *line;
     pcb_t *curr_pcb;
     int curr_pid = 0;
     int error_code = 0;
@@ -211,11 +358,16 @@ int aging_policy() {
         if (get_pcb_for_pid(curr_pid, &curr_pcb)) {
             return 1; // TODO better error: no such pcb
         }
+        account_slice_start(curr_pcb);
+        trace_dispatch(curr_pid);
 
         if (!get_memory_at(curr_pid, curr_pcb->code_offset, &line) && line) {
-            error_code = parseInput(line);
+            error_code = run_tokenized_line(line);
             curr_pcb->code_offset++;
+            trace_event(TRACE_PREEMPT, curr_pid, NULL);
+            account_slice_end(curr_pcb);
         } else {
+            trace_event(TRACE_EXIT, curr_pid, NULL);
             ready_queue_pop(&curr_pid);
             free_pcb_for_pid(curr_pid);
             free_page_table_for_pid(curr_pid);
@@ -1,8 +1,31 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include "interpreter.h"
+
+// One command of a line: the builtin, and its words, which point into the line's text.
+typedef struct {
+    command_t command;
+    int argc;
+    char **argv;
+} instruction_t;
+
+// A line split into the commands of its chain, so that it can be run any number of times without parsing it again.
+typedef struct {
+    int num_instructions;
+    instruction_t *instructions;
+    char *text; // every word, NUL-terminated, one after the other
+    int text_size;
+} tokenized_line_t;
+
 int parseInput(char inp[]);
+int parse_line(const char *inp, int len);
+tokenized_line_t *tokenize_line(const char *inp, int len);
+int run_tokenized_line(tokenized_line_t *line);
+int parse_round_robin_quantum(char *policy, int *pquantum);
+int is_valid_policy(char *policy);
 int run_scheduler();
+void trace_dispatch(int pid);
 int sequential_policy();
 int round_robin_policy(int max_timer);
 int aging_policy();
@@ -2,16 +2,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h> // ffsl
 #include <unistd.h>
 
+#include "codememory.h"
 #include "errors.h"
 #include "schedulermemory.h"
 #include "setup.h"
 #include "shell.h"
 
-char **process_code_memory[MAX_NUM_PROCESSES];
+// The process table, indexed by pid. It grows as needed, so there is no limit on the number of processes.
+pcb_t **pcb_array = NULL;
+int pcb_array_capacity = 0;
 
-pcb_t *pcb_array[MAX_NUM_PROCESSES] = {NULL};
+// One bit per pid in pcb_array, set when the pid is in use.
+unsigned long *used_pids = NULL;
+// No word of used_pids before this one has a free pid.
+int first_free_pid_word = 0;
+
+#define PID_WORD_BITS ((int) (8 * sizeof(unsigned long)))
+
+// The last EXITED_HISTORY_SIZE processes to exit, as a ring.
+pcb_t exited_pcbs[EXITED_HISTORY_SIZE];
+int num_exited = 0;
+
+// pid of the process that was last given a slice, to count context switches.
+int last_run_pid = -1;
+
+char top_enabled = 0;
+long long top_last_shown_ns = 0;
 
 ready_queue_t ready_queue = {NULL, NULL, 0};
 
@@ -40,20 +59,57 @@ void set_process_running(int pid) {
 }
 
 /**
-* Finds the first available pid.
+* Doubles the size of the process table.
+*
+* @return:
+*   - 0 if success
+*   - error code when not ok
+*/
+int grow_process_table() {
+    int new_capacity = pcb_array_capacity ? 2 * pcb_array_capacity : INITIAL_NUM_PROCESSES;
+    pcb_t **new_pcb_array = realloc(pcb_array, new_capacity * sizeof(pcb_t *));
+    if (!new_pcb_array) {
+        return badcommandOutOfPIDs();
+    }
+    pcb_array = new_pcb_array;
+
+    unsigned long *new_used_pids = realloc(used_pids, new_capacity / PID_WORD_BITS * sizeof(unsigned long));
+    if (!new_used_pids) {
+        return badcommandOutOfPIDs();
+    }
+    used_pids = new_used_pids;
+
+    memset(pcb_array + pcb_array_capacity, 0, (new_capacity - pcb_array_capacity) * sizeof(pcb_t *));
+    memset(used_pids + pcb_array_capacity / PID_WORD_BITS, 0,
+           (new_capacity - pcb_array_capacity) / PID_WORD_BITS * sizeof(unsigned long));
+    pcb_array_capacity = new_capacity;
+    return 0;
+}
+
+/**
+* Finds the first available pid, growing the process table if every pid is in use.
 * Places the index of that slot in pointer ppid
 * @return: 
 *   - 0 if success
 *   - error code when not ok
 */
 int find_free_pid(int *ppid) {
-    for (int i = 0; i < MAX_NUM_PROCESSES; i++) {
-        if (!pcb_array[i]) {
-            *ppid = i;
+    int num_words = pcb_array_capacity / PID_WORD_BITS;
+
+    // Every word before first_free_pid_word is full, so this usually looks at just one word.
+    for (int i = first_free_pid_word; i < num_words; i++) {
+        if (~used_pids[i]) {
+            first_free_pid_word = i;
+            *ppid = i * PID_WORD_BITS + ffsl(~used_pids[i]) - 1;
             return 0;
         }
     }
-    return badcommandOutOfPIDs();
+
+    int error_code = grow_process_table();
+    if (error_code) { return error_code; }
+    first_free_pid_word = num_words;
+    *ppid = num_words * PID_WORD_BITS;
+    return 0;
 }
 
 /**
@@ -64,8 +120,12 @@ int find_free_pid(int *ppid) {
 *  - 1 if no process exist with pid.
 */
 int get_pcb_for_pid(int pid, pcb_t **ppcb) {
-   *ppcb = pcb_array[pid]; 
-    return (ppcb == NULL);
+    if (pid < 0 || pid >= pcb_array_capacity) {
+        *ppcb = NULL;
+        return 1;
+    }
+    *ppcb = pcb_array[pid]; 
+    return (*ppcb == NULL);
 }
 
 /**
@@ -81,14 +141,40 @@ int create_pcb_for_pid(int pid, int line_count) {
     } 
     pcb_t *curr_pcb = malloc(sizeof(pcb_t));
     curr_pcb->pid = pid;
-    curr_pcb->code = process_code_memory[pid];
+    curr_pcb->code = NULL;
     curr_pcb->code_offset = 0;
     curr_pcb->job_length_score = line_count;
+    curr_pcb->quanta = 0;
+    curr_pcb->context_switches = 0;
+    curr_pcb->page_faults = 0;
+    curr_pcb->created_ns = monotonic_ns();
+    curr_pcb->ready_since_ns = curr_pcb->created_ns;
+    curr_pcb->ready_ns = 0;
+    curr_pcb->exited_ns = 0;
+    curr_pcb->name = NULL;
 
     pcb_array[pid] = curr_pcb;
+    used_pids[pid / PID_WORD_BITS] |= 1UL << (pid % PID_WORD_BITS);
     return 0;
 }
 
+/**
+* Keeps a copy of a pcb that is about to be freed, so ps can still show its turnaround.
+* Must be called while the process still has its page table, to copy its name.
+*
+* @param pcb the pcb of the exiting process
+*/
+void remember_exited_pcb(pcb_t *pcb) {
+    pcb_t *copy = &exited_pcbs[num_exited % EXITED_HISTORY_SIZE];
+    free(copy->name);
+
+    *copy = *pcb;
+    copy->exited_ns = monotonic_ns();
+    char *name = get_process_name(pcb->pid);
+    copy->name = name ? strdup(name) : NULL;
+    num_exited++;
+}
+
 /**
 * Frees the memory allocated for a pcb at a pid.
 *
@@ -97,8 +183,13 @@ int create_pcb_for_pid(int pid, int line_count) {
 *   - 0
 */
 int free_pcb_for_pid(int pid) {
+    remember_exited_pcb(pcb_array[pid]);
     free(pcb_array[pid]);
     pcb_array[pid] = NULL;
+    used_pids[pid / PID_WORD_BITS] &= ~(1UL << (pid % PID_WORD_BITS));
+    if (pid / PID_WORD_BITS < first_free_pid_word) {
+        first_free_pid_word = pid / PID_WORD_BITS;
+    }
     return 0;
 }
 
@@ -281,4 +372,94 @@ void ready_queue_reorder_aging(int pid) {
     }
 }
 
+/**
+* Accounts for a process being given a slice. Call before it runs.
+*
+* @param pcb the pcb of the process
+*/
+void account_slice_start(pcb_t *pcb) {
+    pcb->ready_ns += monotonic_ns() - pcb->ready_since_ns;
+    pcb->quanta++;
+    if (pcb->pid != last_run_pid) {
+        pcb->context_switches++;
+        last_run_pid = pcb->pid;
+    }
+}
+
+/**
+* Accounts for a process going back on the ready queue at the end of its slice.
+* If top is on, shows the process table again when it's due.
+*
+* @param pcb the pcb of the process
+*/
+void account_slice_end(pcb_t *pcb) {
+    pcb->ready_since_ns = monotonic_ns();
+    if (top_enabled && pcb->ready_since_ns - top_last_shown_ns >= TOP_REFRESH_MS * 1000000LL) {
+        start_top();
+    }
+}
+
+/**
+* Prints a row of the process table.
+*
+* @param pcb the pcb to print
+* @param name the name to show
+* @param state R running, Q ready, X exited
+* @param now the current monotonic_ns()
+*/
+void print_process_row(pcb_t *pcb, char *name, char state, long long now) {
+    long long ready_ns = pcb->ready_ns;
+    if (state == 'Q') {
+        ready_ns += now - pcb->ready_since_ns;
+    }
+    long long end_ns = pcb->exited_ns ? pcb->exited_ns : now;
+
+    printf("%5d %c  %-16s %6d %6d %5d %6d %9lld %9lld %5d\n",
+           pcb->pid, state, name ? name : "(shell)", pcb->code_offset, pcb->quanta,
+           pcb->context_switches, pcb->page_faults, ready_ns / 1000000,
+           (end_ns - pcb->created_ns) / 1000000,
+           state == 'X' ? 0 : count_resident_pages(pcb->pid));
+}
 
+/**
+* Prints the accounting of every live process, then of the recently exited ones.
+* INSNS is instructions executed, CSW context switches, PF page faults and FRAMES resident frames.
+*/
+void print_process_table() {
+    long long now = monotonic_ns();
+
+    printf("  PID ST NAME              INSNS QUANTA   CSW     PF  READY_MS   TURN_MS FRAMES\n");
+    for (int pid = 0; pid < pcb_array_capacity; pid++) {
+        pcb_t *pcb = pcb_array[pid];
+        if (pcb) {
+            print_process_row(pcb, get_process_name(pid), pid == curr_pid ? 'R' : 'Q', now);
+        }
+    }
+
+    int first = num_exited > EXITED_HISTORY_SIZE ? num_exited - EXITED_HISTORY_SIZE : 0;
+    for (int i = first; i < num_exited; i++) {
+        pcb_t *pcb = &exited_pcbs[i % EXITED_HISTORY_SIZE];
+        print_process_row(pcb, pcb->name, 'X', now);
+    }
+}
+
+/**
+* Shows the process table, and keeps showing it every TOP_REFRESH_MS until the scheduler stops.
+* The screen is cleared first if stdout is a terminal.
+*/
+void start_top() {
+    top_enabled = 1;
+    if (isatty(STDOUT_FILENO)) {
+        printf("\033[H\033[2J");
+    }
+    print_process_table();
+    fflush(stdout);
+    top_last_shown_ns = monotonic_ns();
+}
+
+/**
+* Stops top from refreshing.
+*/
+void stop_top() {
+    top_enabled = 0;
+}
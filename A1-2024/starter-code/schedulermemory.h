@@ -4,10 +4,23 @@
 typedef struct {
     int pid;
     char **code;
-    int code_offset;
+    int code_offset; // also the number of instructions executed
     int job_length_score; // initialized to line_count
+
+    // Accounting, for ps and top. Times are from monotonic_ns(), and only read at slice boundaries.
+    int quanta;
+    int context_switches;
+    int page_faults;
+    long long created_ns;
+    long long ready_since_ns;
+    long long ready_ns;
+    long long exited_ns; // 0 while the process is alive
+    char *name; // only set on the copies kept by free_pcb_for_pid
 } pcb_t;
 
+#define EXITED_HISTORY_SIZE 8 // ps shows this many exited processes
+#define TOP_REFRESH_MS 1000
+
 typedef struct ready_queue_node_t {
     int pid;
     struct ready_queue_node_t *next;
@@ -34,5 +47,10 @@ int ready_queue_peek(int *ppid);
 int get_ready_queue_size();
 void ready_queue_reorder_sjf();
 void ready_queue_reorder_aging();
+void account_slice_start(pcb_t *pcb);
+void account_slice_end(pcb_t *pcb);
+void print_process_table();
+void start_top();
+void stop_top();
 
 #endif
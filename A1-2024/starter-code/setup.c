@@ -1,6 +1,9 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
+#include "scan.h"
 #include "setup.h"
 
 /**
@@ -14,37 +17,89 @@ int num_frames() {
 }
 
 /**
-* Determines if a character is a word ending character.
+* Records where a line starts, growing the array of offsets as needed.
 *
-* @param c the character to check 
-* @return:
-*   - 0 if c is not a word ending character
-*   - 1 if c is a word ending character
+* @param offsets the array, or NULL if only counting
+* @param capacity its capacity
+* @param line_count the number of lines recorded so far, which is incremented
+* @param offset where the line starts
 */
-int wordEnding(char c) {
-    // You may want to add ';' to this at some point,
-    // or you may want to find a different way to implement chains.
-    return c == '\0' || c == '\n' || c == ' ' || c == ';';
+void add_line_offset(long **offsets, int *capacity, int *line_count, long offset) {
+    if (offsets) {
+        if (*line_count >= *capacity) {
+            *capacity = *capacity ? 2 * *capacity : 64;
+            *offsets = realloc(*offsets, *capacity * sizeof(long));
+        }
+        (*offsets)[*line_count] = offset;
+    }
+    (*line_count)++;
 }
 
 /**
-* Returns the number of lines in file p.
+* Finds where each line of file p starts, reading it from its current position to the end.
+* Lines are split as fgets(line, MAX_USER_INPUT, p) would split them: a line that is too long for the buffer
+* counts as several. The file is read in large blocks, and the newlines of each are found with scan_newlines.
+*
+* @param p the file
+* @param offsets if not NULL, gets a malloc'd array of where each line starts, relative to where p was,
+*                then the end of the file
+* @return:
+*   - the number of lines in file p
 */
-int count_lines_in_file(FILE *p) {
-    char line[MAX_USER_INPUT];
-    int current_line = 0;
-    
-    while(p) {
-        if (feof(p)) {
-            break;
-        }
-        if (!fgets(line, MAX_USER_INPUT, p)) {
-            break;
+int index_lines_in_file(FILE *p, long **offsets) {
+    char block[1 << 14];
+    unsigned short newlines[1 << 14];
+    int capacity = 0;
+    int line_count = 0;
+    long line_start = 0; // where the line being read starts
+    long block_start = 0; // where block starts
+    size_t n;
+
+    if (offsets) {
+        *offsets = NULL;
+    }
+    while (p && (n = fread(block, 1, sizeof(block), p)) > 0) {
+        size_t num_newlines = scan_newlines(block, n, newlines);
+        for (size_t i = 0; i < num_newlines; i++) {
+            long next_line = block_start + newlines[i] + 1;
+            // fgets stops short of a newline that is too far away, and leaves it for the next line
+            for (; next_line - line_start > MAX_USER_INPUT - 1; line_start += MAX_USER_INPUT - 1) {
+                add_line_offset(offsets, &capacity, &line_count, line_start);
+            }
+            if (offsets) {
+                add_line_offset(offsets, &capacity, &line_count, line_start);
+            } else {
+                line_count++; // the usual case, when only counting, without a call for every line
+            }
+            line_start = next_line;
         }
-        current_line++;
+        block_start += n;
+    }
+    // a last line without a newline still counts
+    for (; line_start < block_start; line_start += MAX_USER_INPUT - 1) {
+        add_line_offset(offsets, &capacity, &line_count, line_start);
+    }
+    if (offsets) {
+        add_line_offset(offsets, &capacity, &line_count, block_start);
+        line_count--; // the end of the file isn't a line
     }
 
-    return current_line;
+    return line_count;
+}
 
+/**
+* Returns the number of lines in file p.
+*/
+int count_lines_in_file(FILE *p) {
+    return index_lines_in_file(p, NULL);
 }
 
+/**
+* Returns the time on CLOCK_MONOTONIC, in nanoseconds.
+* Only read at slice boundaries, to keep process accounting cheap.
+*/
+long long monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -4,12 +4,13 @@
 #include <stdio.h>
 
 #define MAX_USER_INPUT 1000
-#define MAX_NUM_PROCESSES 5
+#define INITIAL_NUM_PROCESSES 64 // the process table starts this big, and doubles when full; a multiple of 64
 #define PAGE_SIZE 3
 #define MAX_PAGE_TABLE_ENTRIES 100
 
 int num_frames();
-int wordEnding(char c);
 int count_lines_in_file(FILE *p);
+int index_lines_in_file(FILE *p, long **offsets);
+long long monotonic_ns();
 
 #endif
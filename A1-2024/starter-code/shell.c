@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> 
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "codememory.h"
@@ -11,6 +13,91 @@
 #include "setup.h"
 #include "shell.h"
 #include "shellmemory.h"
+#include "trace.h"
+
+// Batch input. Through stdio, every byte of a batch file is copied into the FILE's buffer and then into userInput, which
+// is cleared after every line. When stdin is a regular file it is mapped instead, and each line is parsed right where
+// it is in the mapping. The lines are the same ones fgets would read, long ones split the same way, and eof is set when
+// feof(stdin) would be. Pipes and terminals can't be mapped, and still go through fgets.
+typedef struct {
+    const char *map; // the mapping, or NULL if stdin isn't mapped
+    size_t map_size;
+    const char *data; // where stdin was when the shell started
+    size_t size; // how much of it there is
+    size_t pos; // how much of it has been read
+    off_t start; // the offset in stdin of data
+    int eof;
+} batch_input_t;
+
+batch_input_t batch_input = {0};
+
+/**
+* Maps stdin, if it's a regular file with something left to read.
+*/
+void map_batch_input() {
+    struct stat st;
+    if (fstat(0, &st) || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    off_t start = lseek(0, 0, SEEK_CUR); // whatever was read before the shell started isn't ours
+    if (start < 0 || start >= st.st_size) {
+        return;
+    }
+    off_t map_start = start - start % sysconf(_SC_PAGESIZE); // mmap wants a whole number of pages
+    size_t map_size = st.st_size - map_start;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, 0, map_start);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    madvise(map, map_size, MADV_SEQUENTIAL);
+    lseek(0, 0, SEEK_END); // as if it were all read ahead, so programs sharing stdin don't get the batch file again
+
+    batch_input.map = map;
+    batch_input.map_size = map_size;
+    batch_input.data = batch_input.map + (start - map_start);
+    batch_input.size = st.st_size - start;
+    batch_input.pos = 0;
+    batch_input.start = start;
+    batch_input.eof = 0;
+}
+
+/**
+* Returns the next line of the mapped stdin, as fgets(userInput, MAX_USER_INPUT-1, stdin) would read it: up to and
+* including a newline, but no more than MAX_USER_INPUT-2 characters.
+*
+* @param len gets how many characters the line has; it is 0 at the end
+* @return:
+*   - where the line starts; it doesn't end in a NUL
+*/
+const char *next_batch_line(int *len) {
+    const char *line = batch_input.data + batch_input.pos;
+    size_t left = batch_input.size - batch_input.pos;
+    size_t max = MAX_USER_INPUT - 2;
+    const char *newline = memchr(line, '\n', left < max ? left : max);
+    if (newline) {
+        *len = newline - line + 1;
+    } else if (left >= max) {
+        *len = max; // fgets stops when the buffer is full, without looking for the end of the file
+    } else {
+        *len = left;
+        batch_input.eof = 1;
+    }
+    batch_input.pos += *len;
+    return line;
+}
+
+/**
+* Lets go of the mapped stdin, leaving stdin just after the last line read from it, so that it can be read through
+* stdio. Anything else that reads stdin must call this first.
+*/
+void release_batch_input() {
+    if (!batch_input.map) {
+        return;
+    }
+    fseek(stdin, batch_input.start + batch_input.pos, SEEK_SET);
+    munmap((void *) batch_input.map, batch_input.map_size);
+    batch_input.map = NULL;
+}
 
 // Start of everything
 int main(int argc, char *argv[]) {
@@ -34,18 +121,28 @@ int main(int argc, char *argv[]) {
 
     //init shell memory
     mem_init();
+    trace_init();
+    if (!isatty(0)) {
+        map_batch_input();
+    }
     while(1) {							
         if (isatty(0)){
             printf("%c ", prompt);
-        } else if (feof(stdin)) {
+        } else if (batch_input.map ? batch_input.eof : feof(stdin)) {
+            release_batch_input();
             deinit();
             break;
         }
-        fgets(userInput, MAX_USER_INPUT-1, stdin);
-        
-        errorCode = parseInput(userInput);
+        if (batch_input.map) {
+            int len;
+            const char *line = next_batch_line(&len);
+            errorCode = parse_line(line, strnlen(line, len)); // a NUL ends the line, as it would in userInput
+        } else {
+            fgets(userInput, MAX_USER_INPUT-1, stdin);
+            errorCode = parseInput(userInput);
+            memset(userInput, 0, sizeof(userInput));
+        }
         if (errorCode == -1) exit(99);	// ignore all other errors
-        memset(userInput, 0, sizeof(userInput));
     }
 
     return 0;
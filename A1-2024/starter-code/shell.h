@@ -2,5 +2,6 @@
 #define SHELL_H
 
 int parseInput(char inp[]);
+void release_batch_input();
 
 #endif
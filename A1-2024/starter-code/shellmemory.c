@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -5,53 +6,142 @@
 #include "setup.h"
 #include "shellmemory.h"
 
+// The variables live in an open-addressing hash table with Robin Hood probing, so set and get are O(1)
+// however many variables there are. A variable goes in the first free slot from its home slot (hash & mask),
+// taking the place of any variable it passes that is closer to its own home; lookups can therefore stop at
+// the first variable closer to home than theirs would be. Deletion shifts the following variables back
+// instead of leaving tombstones. The table starts with room for VAR_MEM_SIZE variables and doubles at 7/8 full.
+
 struct memory_struct {
-    char *var;
+    char *var; // NULL if the slot is empty
     char *value;
+    uint64_t hash;
 };
 
-struct memory_struct shellmemory[VAR_MEM_SIZE];
+struct memory_struct *shellmemory = NULL;
+size_t shellmemory_capacity = 0; // a power of 2
+size_t shellmemory_count = 0;
+
+#define NOT_FOUND ((size_t) -1)
 
 /**
-* Compares two strings to see if they are equal.
+* Hashes a variable name with FNV-1a.
 *
-* @param:
-*   - model: the string to compare against
-*   - var: the string to compare
+* @param name the variable name
+* @return the hash
+*/
+uint64_t hash_var_name(char *name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *name; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+* Computes how far a slot is past the home slot of a hash.
+*
+* @param hash the hash of the variable in the slot
+* @param slot the slot
+* @return the probe distance
+*/
+size_t probe_distance(uint64_t hash, size_t slot) {
+    return (slot - hash) & (shellmemory_capacity - 1);
+}
+
+/**
+* Finds the slot of a variable.
+*
+* @param var_in the variable name
+* @param hash its hash
 * @return:
-*   - 1 if the strings are equal
-*   - 0 if the strings are not equal
+*   - the slot
+*   - NOT_FOUND if the variable is not set
+*/
+size_t find_var_slot(char *var_in, uint64_t hash) {
+    size_t mask = shellmemory_capacity - 1;
+    size_t slot = hash & mask;
+    for (size_t dist = 0; ; dist++, slot = (slot + 1) & mask) {
+        struct memory_struct *entry = &shellmemory[slot];
+        if (!entry->var || probe_distance(entry->hash, slot) < dist) {
+            return NOT_FOUND; // had var_in been here, it would have displaced entry
+        }
+        if (entry->hash == hash && strcmp(entry->var, var_in) == 0) {
+            return slot;
+        }
+    }
+}
+
+/**
+* Inserts a variable that is not in the table yet, taking ownership of its strings. There must be a free slot.
+*
+* @param entry the variable
+*/
+void insert_var(struct memory_struct entry) {
+    size_t mask = shellmemory_capacity - 1;
+    size_t slot = entry.hash & mask;
+    size_t dist = 0;
+
+    while (shellmemory[slot].var) {
+        size_t other_dist = probe_distance(shellmemory[slot].hash, slot);
+        if (other_dist < dist) {
+            // the entry further from home takes the slot; the displaced one keeps looking
+            struct memory_struct displaced = shellmemory[slot];
+            shellmemory[slot] = entry;
+            entry = displaced;
+            dist = other_dist;
+        }
+        slot = (slot + 1) & mask;
+        dist++;
+    }
+    shellmemory[slot] = entry;
+    shellmemory_count++;
+}
+
+/**
+* Resizes the table to new_capacity slots, a power of 2, and reinserts every variable.
+*
+* @param new_capacity the new number of slots
 */
-int match(char *model, char *var) {
-    int len = strlen(var);
-    int matchCount = 0;
-    for (int i = 0; i < len; i++) {
-        if (model[i] == var[i]) matchCount++;
+void resize_shellmemory(size_t new_capacity) {
+    struct memory_struct *old = shellmemory;
+    size_t old_capacity = shellmemory_capacity;
+
+    shellmemory = calloc(new_capacity, sizeof(struct memory_struct));
+    shellmemory_capacity = new_capacity;
+    shellmemory_count = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].var) {
+            insert_var(old[i]);
+        }
     }
-    return (matchCount == len);
+    free(old);
 }
 
 /**
 * Initializes the shell memory.
 */
 void mem_init() {
-    for (int i = 0; i < VAR_MEM_SIZE; i++){
-        shellmemory[i].var   = NULL;
-        shellmemory[i].value = NULL;
+    size_t capacity = 16;
+    while (capacity < VAR_MEM_SIZE) {
+        capacity *= 2;
     }
+    resize_shellmemory(capacity);
 }
 
 /**
 * Deinitializes the shell memory.
 */
 void mem_deinit() {
-    for (int i = 0; i < VAR_MEM_SIZE; i++) {
+    for (size_t i = 0; i < shellmemory_capacity; i++) {
         free(shellmemory[i].var);
         free(shellmemory[i].value);
-
-        shellmemory[i].var = NULL;
-        shellmemory[i].value = NULL;
     }
+    free(shellmemory);
+    shellmemory = NULL;
+    shellmemory_capacity = 0;
+    shellmemory_count = 0;
 }
 
 /**
@@ -62,26 +152,21 @@ void mem_deinit() {
 *   - value_in: the value to set
 */
 void mem_set_value(char *var_in, char *value_in) {
-    int i;
-
-    for (i = 0; i < VAR_MEM_SIZE; i++){
-        if (shellmemory[i].var && strcmp(shellmemory[i].var, var_in) == 0){
-            free(shellmemory[i].value);
-            shellmemory[i].value = strdup(value_in);
-            return;
-        } 
+    uint64_t hash = hash_var_name(var_in);
+    size_t slot = find_var_slot(var_in, hash);
+
+    if (slot != NOT_FOUND) {
+        free(shellmemory[slot].value);
+        shellmemory[slot].value = strdup(value_in);
+        return;
     }
 
     //Value does not exist, need to find a free spot.
-    for (i = 0; i < VAR_MEM_SIZE; i++){
-        if (!shellmemory[i].var){
-            shellmemory[i].var   = strdup(var_in);
-            shellmemory[i].value = strdup(value_in);
-            return;
-        } 
+    if (8 * (shellmemory_count + 1) > 7 * shellmemory_capacity) {
+        resize_shellmemory(2 * shellmemory_capacity);
     }
-
-    return;
+    struct memory_struct entry = { strdup(var_in), strdup(value_in), hash };
+    insert_var(entry);
 }
 
 /**
@@ -94,13 +179,58 @@ void mem_set_value(char *var_in, char *value_in) {
 *   - NULL if the key does not exist
 */
 char *mem_get_value(char *var_in) {
-    int i;
+    const char *value = mem_view_value(var_in);
+    if (!value) {
+        return NULL;
+    }
+    return strdup(value);
+}
+
+/**
+* Gets the value of a key in shell memory without copying it.
+* The returned view is only valid until the next mem_set_value(), mem_unset_value() or mem_deinit(),
+* which may free it; use mem_get_value() to keep the value for longer. Resizing the table does not move the value.
+*
+* @param:
+*   - var_in: the key to get the value of
+* @return:
+*   - the value of the key, which must not be modified or freed
+*   - NULL if the key does not exist
+*/
+const char *mem_view_value(char *var_in) {
+    size_t slot = find_var_slot(var_in, hash_var_name(var_in));
+    if (slot == NOT_FOUND) {
+        return NULL;
+    }
+    return shellmemory[slot].value;
+}
+
+/**
+* Removes a key from shell memory. The following entries are shifted back, so no tombstone is left.
+*
+* @param:
+*   - var_in: the key to remove
+* @return:
+*   - 0 if the key was removed
+*   - 1 if the key does not exist
+*/
+int mem_unset_value(char *var_in) {
+    size_t mask = shellmemory_capacity - 1;
+    size_t slot = find_var_slot(var_in, hash_var_name(var_in));
+    if (slot == NOT_FOUND) {
+        return 1;
+    }
+    free(shellmemory[slot].var);
+    free(shellmemory[slot].value);
+    shellmemory_count--;
 
-    for (i = 0; i < VAR_MEM_SIZE; i++){
-        if (shellmemory[i].var && strcmp(shellmemory[i].var, var_in) == 0){
-            return strdup(shellmemory[i].value);
-        } 
+    size_t next = (slot + 1) & mask;
+    while (shellmemory[next].var && probe_distance(shellmemory[next].hash, next) > 0) {
+        shellmemory[slot] = shellmemory[next];
+        slot = next;
+        next = (next + 1) & mask;
     }
-    
-    return NULL;
+    shellmemory[slot].var = NULL;
+    shellmemory[slot].value = NULL;
+    return 0;
 }
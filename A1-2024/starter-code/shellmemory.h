@@ -1,4 +1,6 @@
 void mem_init();
 void mem_deinit();
 char *mem_get_value(char *var);
+const char *mem_view_value(char *var);
 void mem_set_value(char *var, char *value);
+int mem_unset_value(char *var);
@@ -0,0 +1,191 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "setup.h"
+
+#include "trace.h"
+
+// A timeline of the scheduler, in the Chrome trace-event format, for Perfetto (ui.perfetto.dev)
+// or chrome://tracing. Off unless MYSH_TRACE names the file to write it to at exit.
+// Events go in a ring buffer per thread, which only that thread writes to, so recording takes no locks.
+// When a ring is full, its oldest events are overwritten.
+
+typedef struct {
+    long long ts;
+    int pid;
+    int kind;
+    char name[16];
+} trace_record_t;
+
+typedef struct trace_ring_t {
+    trace_record_t records[TRACE_RING_SIZE];
+    long long written; // events ever recorded; the newest is at (written - 1) % TRACE_RING_SIZE
+    int thread_index;
+    struct trace_ring_t *next;
+} trace_ring_t;
+
+int trace_enabled = 0;
+char *trace_path = NULL;
+_Atomic(trace_ring_t *) trace_rings = NULL; // every thread's ring, newest first; never shrinks
+atomic_int trace_threads_seen = 0;
+_Thread_local trace_ring_t *my_trace_ring = NULL;
+
+/**
+* Allocates the calling thread's ring and pushes it on trace_rings with a compare-and-swap.
+*
+* @return:
+*   - the ring
+*   - NULL if out of memory
+*/
+trace_ring_t *register_trace_ring() {
+    trace_ring_t *ring = malloc(sizeof(trace_ring_t));
+    if (!ring) {
+        return NULL;
+    }
+    ring->written = 0;
+    ring->thread_index = atomic_fetch_add(&trace_threads_seen, 1) + 1;
+    ring->next = atomic_load(&trace_rings);
+    while (!atomic_compare_exchange_weak(&trace_rings, &ring->next, ring)) {
+        // ring->next now holds the current head; try again
+    }
+    return ring;
+}
+
+/**
+* Records a scheduler event, stamped with monotonic_ns(). Does nothing unless tracing is on.
+*
+* @param kind what happened
+* @param pid the process it happened to
+* @param name for TRACE_DISPATCH, the label of the slice (copied, up to 15 characters); otherwise ignored, may be NULL
+*/
+void trace_event(trace_event_kind_t kind, int pid, char *name) {
+    if (!trace_enabled) {
+        return;
+    }
+    if (!my_trace_ring && !(my_trace_ring = register_trace_ring())) {
+        return;
+    }
+
+    trace_record_t *r = &my_trace_ring->records[my_trace_ring->written % TRACE_RING_SIZE];
+    r->ts = monotonic_ns();
+    r->pid = pid;
+    r->kind = kind;
+    if (name) {
+        strncpy(r->name, name, sizeof(r->name) - 1);
+        r->name[sizeof(r->name) - 1] = '\0';
+    } else {
+        r->name[0] = '\0';
+    }
+    my_trace_ring->written++;
+}
+
+/**
+* Writes the start of a trace event: a B/E pair is a slice, "i" is an instant. Timestamps are in microseconds.
+*
+* @param out the trace file
+* @param pfirst whether this is the first event, so there's no comma before it; cleared
+* @param ph the event type
+* @param thread_index the recording thread, which is the trace's "pid"
+* @param r the record; the process's pid is the trace's "tid", so every process gets a track
+*/
+void write_trace_event_head(FILE *out, int *pfirst, char *ph, int thread_index, trace_record_t *r) {
+    fprintf(out, "%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%lld.%03lld",
+            *pfirst ? "" : ",", ph, thread_index, r->pid, r->ts / 1000, r->ts % 1000);
+    *pfirst = 0;
+}
+
+/**
+* Writes a JSON string, escaping what needs it.
+*/
+void write_trace_string(FILE *out, char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+* Writes the events of one thread's ring, oldest first.
+*/
+void write_trace_ring(FILE *out, int *pfirst, trace_ring_t *ring) {
+    char *instant;
+    long long kept = ring->written < TRACE_RING_SIZE ? ring->written : TRACE_RING_SIZE;
+    int seen_dispatch = 0; // if the ring wrapped, drop the ends of slices whose start was overwritten
+
+    fprintf(out, "%s\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"mysh thread %d\"}}",
+            *pfirst ? "" : ",", ring->thread_index, ring->thread_index);
+    *pfirst = 0;
+
+    for (long long i = ring->written - kept; i < ring->written; i++) {
+        trace_record_t *r = &ring->records[i % TRACE_RING_SIZE];
+        instant = NULL;
+
+        if (r->kind == TRACE_DISPATCH) {
+            seen_dispatch = 1;
+            write_trace_event_head(out, pfirst, "B", ring->thread_index, r);
+            fprintf(out, ",\"name\":");
+            write_trace_string(out, r->name);
+            fputc('}', out);
+        } else if (r->kind == TRACE_PREEMPT || r->kind == TRACE_EXIT) {
+            if (seen_dispatch) {
+                write_trace_event_head(out, pfirst, "E", ring->thread_index, r);
+                fputc('}', out);
+            }
+            if (r->kind == TRACE_EXIT) {
+                instant = "exit";
+            }
+        } else if (r->kind == TRACE_PAGE_FAULT) {
+            instant = "page fault";
+        } else if (r->kind == TRACE_BLOCK) {
+            instant = "blocked";
+        }
+
+        if (instant) {
+            write_trace_event_head(out, pfirst, "i", ring->thread_index, r);
+            fprintf(out, ",\"s\":\"t\",\"name\":\"%s\"}", instant);
+        }
+    }
+}
+
+/**
+* Writes every ring to the MYSH_TRACE file. Registered with atexit by trace_init().
+*/
+void dump_trace() {
+    FILE *out;
+    int first = 1;
+
+    trace_enabled = 0;
+    out = fopen(trace_path, "w");
+    if (!out) {
+        perror("failed to open MYSH_TRACE file");
+        return;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (trace_ring_t *ring = atomic_load(&trace_rings); ring; ring = ring->next) {
+        write_trace_ring(out, &first, ring);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+/**
+* Turns tracing on if the MYSH_TRACE environment variable names a file. Call once, from main.
+*/
+void trace_init() {
+    trace_path = getenv("MYSH_TRACE");
+    if (!trace_path || !*trace_path) {
+        return;
+    }
+    trace_enabled = 1;
+    atexit(dump_trace);
+}
@@ -0,0 +1,17 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_RING_SIZE (1 << 15) // events kept per thread; a power of 2
+
+typedef enum {
+    TRACE_DISPATCH,   // the process starts a slice
+    TRACE_PREEMPT,    // the slice ended and the process went back on the ready queue
+    TRACE_PAGE_FAULT, // the process needed a page that wasn't in the frame store
+    TRACE_BLOCK,      // the process can't run until something happens
+    TRACE_EXIT,       // the slice ended because the process finished
+} trace_event_kind_t;
+
+void trace_init();
+void trace_event(trace_event_kind_t kind, int pid, char *name);
+
+#endif
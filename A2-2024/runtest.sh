@@ -1,7 +1,7 @@
 #!/bin/bash
 
 test_dir="."
-source_code_dir="../starter-code"
+source_code_dir="../solution"
 temp_file="temp.txt"
 
 red='\033[0;31m'
@@ -45,7 +45,7 @@ if [ $# -ge 1 ]; then
     done 
 else
     echo "Did not receive arguments: running all tests in $test_dir"
-    for fname in $( ls $test_dir | grep -v "_result" );
+    for fname in $( ls $test_dir | grep -v -e "_result" -e "P_" -e "README" );
     do
         file_stem="${fname%.*}"
         # echo "running: $file_stem"  # uncomment for debugging
@@ -0,0 +1,76 @@
+// Benchmark for running script lines.
+//
+// Commands typed at the prompt go through parseInput, which splits the
+// line, copies every word, and looks up the builtin, every time. Script
+// lines are compiled once, when their script is read, and run_bytecode (see
+// bytecode.h) only runs the result. This runs the same lines both ways and
+// reports instructions (commands, counting each one of a ';' chain) per
+// second. The lines' output is sent to /dev/null while they run.
+//
+// Build with `make bench` and run ./bench/bench_bytecode [rounds].
+// Each round runs every line once; the default is 200000 rounds.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../bytecode.h"
+#include "../shell.h"
+#include "../shellmemory.h"
+#include "../timing.h"
+
+// Mostly what scripts are made of, plus a builtin that isn't compiled any
+// further and a line the interpreter rejects.
+static const char *lines[] = {
+    "set x hello world",
+    "print x",
+    "echo $x",
+    "echo hello",
+    "set y 1; set z 2; print y; echo $z",
+    "print nobody",
+    "my_cd .",
+    "nonsense here",
+};
+#define LINE_COUNT (sizeof(lines) / sizeof(lines[0]))
+
+int main(int argc, char *argv[]) {
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    mem_init();
+
+    struct bytecode *code[LINE_COUNT];
+    size_t instructions = 0;
+    for (size_t i = 0; i < LINE_COUNT; ++i) {
+        code[i] = compile_line(lines[i]);
+        instructions += code[i]->count;
+    }
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    uint64_t start = monotonic_ns();
+    for (long r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < LINE_COUNT; ++i) parseInput(lines[i]);
+    }
+    uint64_t parsed_ns = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (long r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < LINE_COUNT; ++i) run_bytecode(code[i]);
+    }
+    uint64_t compiled_ns = monotonic_ns() - start;
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    double total = (double)instructions * rounds;
+    printf("%12s %14s %14s\n", "", "ns/instr", "Minstr/s");
+    printf("%12s %14.1f %14.2f\n", "parseInput", parsed_ns / total, total / parsed_ns * 1000);
+    printf("%12s %14.1f %14.2f\n", "bytecode", compiled_ns / total, total / compiled_ns * 1000);
+
+    for (size_t i = 0; i < LINE_COUNT; ++i) free(code[i]);
+    return 0;
+}
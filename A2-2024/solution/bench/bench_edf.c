@@ -0,0 +1,57 @@
+// Microbenchmark for EDF dispatch.
+//
+// EDF keeps ready PCBs in a heap, so one dispatch (dequeue the earliest
+// deadline, then enqueue it again with a later one, as happens when a slice
+// ends) should cost O(log n). This times that cycle for growing queue sizes;
+// the time per dispatch should grow by a constant step each time n is
+// multiplied by 10, not by a factor of 10.
+//
+// Build with `make bench` and run ./bench/bench_edf.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../pcb.h"
+#include "../queue.h"
+#include "../timing.h"
+
+#define DISPATCHES 1000000
+
+int main() {
+    size_t sizes[] = {10, 100, 1000, 10000, 100000};
+    size_t count = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%10s %16s\n", "n", "ns/dispatch");
+    for (size_t s = 0; s < count; ++s) {
+        size_t n = sizes[s];
+        struct queue *q = alloc_queue();
+        struct PCB *pcbs = calloc(n, sizeof(struct PCB));
+
+        // Deadlines are spread out and interleaved, so the heap really has
+        // to work for its order.
+        srand(1);
+        for (size_t i = 0; i < n; ++i) {
+            pcbs[i].pid = i;
+            pcbs[i].name = "";
+            pcbs[i].next = NULL;
+            pcbs[i].deadline = (uint64_t)rand() * 1000;
+            enqueue_edf(q, &pcbs[i]);
+        }
+
+        uint64_t start = monotonic_ns();
+        for (size_t i = 0; i < DISPATCHES; ++i) {
+            struct PCB *pcb = dequeue_edf(q);
+            pcb->deadline += (uint64_t)rand() * 1000;
+            enqueue_edf(q, pcb);
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        printf("%10zu %16.1f\n", n, (double)elapsed / DISPATCHES);
+
+        // The PCBs aren't real processes, so empty the queue before freeing
+        // it rather than letting free_queue try to clean them up.
+        while (dequeue_edf(q));
+        free_queue(q);
+        free(pcbs);
+    }
+    return 0;
+}
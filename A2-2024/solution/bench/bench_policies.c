@@ -0,0 +1,342 @@
+// Policy benchmark: runs one synthetic workload under every policy that
+// get_policy knows, and reports the results as JSON on stdout.
+//
+// The workload is a number of scripts, each with a length drawn from a
+// distribution, lines drawn from a mix of commands, and an arrival time.
+// Time is measured in instructions executed (ticks), which keeps the
+// waiting/turnaround numbers identical from run to run and from machine to
+// machine; only wall_ns and the throughputs depend on the build.
+//
+// A script arrives once the clock reaches its arrival tick, and then waits
+// for admission like any other process if shellmemory is full. Either way,
+// the wait counts as waiting time. So for a script:
+//   turnaround = finish - arrival
+//   waiting    = turnaround - length
+//
+// Build with `make bench`, then for example:
+//   ./bench/bench_policies -n 200 -len exp:20 -arrival poisson:15
+// Options (defaults in brackets):
+//   -n N                         number of scripts [100]
+//   -len uniform:MIN:MAX         script lengths [uniform:5:30]
+//        exp:MEAN
+//        bimodal:SHORT:LONG:PCT  PCT percent of scripts are LONG
+//   -mix CMD=W,CMD=W,...         command mix, CMD one of echo, set, print,
+//                                my_ls [echo=50,set=30,print=20]
+//   -arrival burst               everything at tick 0 [burst]
+//            uniform:GAP         one every GAP ticks
+//            poisson:MEAN        exponential gaps with the given mean
+//   -seed S                      for the workload generator [1]
+// The scripts' output is sent to /dev/null while they run.
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../pcb.h"
+#include "../queue.h"
+#include "../schedule_policy.h"
+#include "../shellmemory.h"
+#include "../timing.h"
+
+// Every policy name get_policy accepts, with RR<n> represented by RR30.
+static const char *policies[] = {
+    "FCFS", "SJF", "SJFP", "RR", "RR30", "ARR", "AGING", "MLFQ",
+    "CFS", "STRIDE", "LOTTERY", "EDF"
+};
+#define POLICY_COUNT (sizeof(policies) / sizeof(policies[0]))
+
+// EDF gets a deadline this many nanoseconds per line after arrival,
+// so that it has something to order by.
+#define EDF_NS_PER_LINE 20000
+
+struct mix_entry {
+    const char *command;
+    const char *line;
+    unsigned weight;
+};
+
+static struct mix_entry mix[] = {
+    {"echo",  "echo bench",   50},
+    {"set",   "set benchvar 1", 30},
+    {"print", "print benchvar", 20},
+    {"my_ls", "my_ls",        0},
+};
+#define MIX_COUNT (sizeof(mix) / sizeof(mix[0]))
+
+struct config {
+    size_t processes;
+    char len_kind[16];
+    double len_a, len_b, len_c;
+    char arrival_kind[16];
+    double arrival_a;
+    unsigned seed;
+};
+
+// One generated script.
+struct job {
+    char *code;        // the script, lines separated by '\n'
+    size_t length;     // in lines
+    uint64_t arrival;  // in ticks
+};
+
+static double uniform01(unsigned *seed) {
+    return (rand_r(seed) + 0.5) / ((double)RAND_MAX + 1);
+}
+
+static size_t draw_length(const struct config *c, unsigned *seed) {
+    double len;
+    if (strcmp(c->len_kind, "exp") == 0) {
+        len = -c->len_a * log(uniform01(seed));
+    } else if (strcmp(c->len_kind, "bimodal") == 0) {
+        len = uniform01(seed) * 100 < c->len_c ? c->len_b : c->len_a;
+    } else {
+        len = c->len_a + rand_r(seed) % (size_t)(c->len_b - c->len_a + 1);
+    }
+    // Every script fits in shellmemory, or it would be rejected outright.
+    if (len < 1) len = 1;
+    if (len > MEM_SIZE / 2) len = MEM_SIZE / 2;
+    return (size_t)len;
+}
+
+static uint64_t draw_gap(const struct config *c, unsigned *seed) {
+    if (strcmp(c->arrival_kind, "uniform") == 0) return c->arrival_a;
+    if (strcmp(c->arrival_kind, "poisson") == 0) {
+        return (uint64_t)(-c->arrival_a * log(uniform01(seed)));
+    }
+    return 0; // burst
+}
+
+static const char *draw_line(unsigned *seed) {
+    unsigned total = 0;
+    for (size_t i = 0; i < MIX_COUNT; ++i) total += mix[i].weight;
+    unsigned pick = rand_r(seed) % total;
+    for (size_t i = 0; i < MIX_COUNT; ++i) {
+        if (pick < mix[i].weight) return mix[i].line;
+        pick -= mix[i].weight;
+    }
+    return mix[0].line;
+}
+
+static struct job *generate(const struct config *c) {
+    struct job *jobs = calloc(c->processes, sizeof(struct job));
+    unsigned seed = c->seed;
+    uint64_t arrival = 0;
+    for (size_t i = 0; i < c->processes; ++i) {
+        jobs[i].length = draw_length(c, &seed);
+        jobs[i].arrival = arrival;
+        arrival += draw_gap(c, &seed);
+
+        // Longest line, plus the newline.
+        jobs[i].code = malloc(jobs[i].length * 16 + 1);
+        char *end = jobs[i].code;
+        for (size_t l = 0; l < jobs[i].length; ++l) {
+            // No newline after the last line; a trailing one would be read
+            // as an extra, blank line.
+            end += sprintf(end, l ? "\n%s" : "%s", draw_line(&seed));
+        }
+    }
+    return jobs;
+}
+
+// Per-script results of one run.
+struct outcome {
+    struct PCB *pcb;   // while the script is alive
+    uint64_t finish;
+};
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values.
+static uint64_t percentile(const uint64_t *sorted, size_t n, double p) {
+    size_t rank = (size_t)ceil(p * n);
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static void print_stats(const char *name, uint64_t *values, size_t n) {
+    qsort(values, n, sizeof(uint64_t), compare_u64);
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += values[i];
+    printf("\"%s\": {\"mean\": %.2f, \"p50\": %llu, \"p99\": %llu}",
+           name, sum / n,
+           (unsigned long long)percentile(values, n, 0.50),
+           (unsigned long long)percentile(values, n, 0.99));
+}
+
+static struct PCB *make_process(struct job *job, size_t index) {
+    FILE *f = fmemopen(job->code, strlen(job->code), "r");
+    struct PCB *pcb = create_process_from_FILE(f);
+    // A nameless process is the shell input, which policies treat specially.
+    char name[32];
+    snprintf(name, sizeof(name), "bench%zu", index);
+    pcb->name = strdup(name);
+    return pcb;
+}
+
+// Run every job under the named policy and print its JSON object.
+static void run_policy(const char *policy_name, struct job *jobs, size_t n) {
+    struct schedule_policy policy;
+    get_policy(policy_name, &policy);
+    struct queue *q = alloc_queue();
+    struct outcome *out = calloc(n, sizeof(struct outcome));
+
+    // Keep the scripts' output off the JSON.
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    uint64_t clock = 0, context_switches = 0, dispatches = 0;
+    size_t next_arrival = 0, next_admission = 0, finished = 0;
+    pid last_pid = 0;
+    uint64_t wall_start = monotonic_ns();
+
+    while (finished < n) {
+        // Scripts arrive in order, and are admitted in order.
+        for (; next_arrival < n && jobs[next_arrival].arrival <= clock; ++next_arrival) {
+            out[next_arrival].pcb = make_process(&jobs[next_arrival], next_arrival);
+        }
+        for (; next_admission < next_arrival; ++next_admission) {
+            struct PCB *pcb = out[next_admission].pcb;
+            if (pcb_load(pcb)) break;
+            pcb->deadline = monotonic_ns()
+                + jobs[next_admission].length * EDF_NS_PER_LINE;
+            policy.enqueue(q, pcb);
+        }
+
+        if (policy.before_dequeue) policy.before_dequeue(&policy, q);
+        struct PCB *pcb = policy.dequeue(q);
+        if (!pcb) {
+            // Idle until the next arrival. Everything that has arrived is
+            // admitted by now, since an empty queue means empty shellmemory.
+            if (next_arrival == n) break;
+            clock = jobs[next_arrival].arrival;
+            continue;
+        }
+
+        // run_pcb frees the PCB when it finishes, so note what we need now.
+        size_t index = strtoul(pcb->name + strlen("bench"), NULL, 10);
+        size_t start_pc = pcb->pc;
+        size_t remaining = pcb->line_count - pcb->pc;
+        if (pcb->pid != last_pid) context_switches++;
+        last_pid = pcb->pid;
+        dispatches++;
+
+        pcb = policy.run_pcb(&policy, pcb);
+
+        clock += pcb ? pcb->pc - start_pc : remaining;
+        if (pcb) {
+            policy.enqueue(q, pcb);
+        } else {
+            out[index].pcb = NULL;
+            out[index].finish = clock;
+            finished++;
+        }
+    }
+
+    uint64_t wall_ns = monotonic_ns() - wall_start;
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    uint64_t *waiting = malloc(n * sizeof(uint64_t));
+    uint64_t *turnaround = malloc(n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; ++i) {
+        turnaround[i] = out[i].finish - jobs[i].arrival;
+        waiting[i] = turnaround[i] - jobs[i].length;
+    }
+
+    printf("    {\"policy\": \"%s\", \"processes\": %zu, "
+           "\"instructions\": %llu, \"wall_ns\": %llu, "
+           "\"throughput_processes_per_s\": %.1f, "
+           "\"throughput_instructions_per_s\": %.1f, "
+           "\"dispatches\": %llu, \"context_switches\": %llu, ",
+           policy_name, n, (unsigned long long)clock,
+           (unsigned long long)wall_ns, n * 1e9 / wall_ns,
+           clock * 1e9 / wall_ns, (unsigned long long)dispatches,
+           (unsigned long long)context_switches);
+    print_stats("waiting", waiting, n);
+    printf(", ");
+    print_stats("turnaround", turnaround, n);
+    printf("}");
+
+    free(waiting);
+    free(turnaround);
+    free(out);
+    free_queue(q);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-n N] [-len uniform:MIN:MAX|exp:MEAN|"
+            "bimodal:SHORT:LONG:PCT] [-mix CMD=W,...] "
+            "[-arrival burst|uniform:GAP|poisson:MEAN] [-seed S]\n", argv0);
+    exit(1);
+}
+
+static void parse_mix(char *spec, const char *argv0) {
+    for (size_t i = 0; i < MIX_COUNT; ++i) mix[i].weight = 0;
+    for (char *item = strtok(spec, ","); item; item = strtok(NULL, ",")) {
+        char *eq = strchr(item, '=');
+        if (!eq) usage(argv0);
+        *eq = '\0';
+        size_t i = 0;
+        while (i < MIX_COUNT && strcmp(mix[i].command, item) != 0) ++i;
+        if (i == MIX_COUNT) usage(argv0);
+        mix[i].weight = strtoul(eq + 1, NULL, 10);
+    }
+    unsigned total = 0;
+    for (size_t i = 0; i < MIX_COUNT; ++i) total += mix[i].weight;
+    if (total == 0) usage(argv0);
+}
+
+int main(int argc, char *argv[]) {
+    struct config c = {100, "uniform", 5, 30, 0, "burst", 0, 1};
+    char len_spec[64] = "uniform:5:30", arrival_spec[64] = "burst";
+    char mix_spec[128] = "echo=50,set=30,print=20";
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 == argc) usage(argv[0]);
+        char *value = argv[++i];
+        if (strcmp(argv[i-1], "-n") == 0) {
+            c.processes = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-len") == 0) {
+            snprintf(len_spec, sizeof(len_spec), "%s", value);
+            int fields = sscanf(value, "%15[a-z]:%lf:%lf:%lf", c.len_kind,
+                                &c.len_a, &c.len_b, &c.len_c);
+            if (fields < 2) usage(argv[0]);
+        } else if (strcmp(argv[i-1], "-mix") == 0) {
+            snprintf(mix_spec, sizeof(mix_spec), "%s", value);
+            parse_mix(value, argv[0]);
+        } else if (strcmp(argv[i-1], "-arrival") == 0) {
+            snprintf(arrival_spec, sizeof(arrival_spec), "%s", value);
+            sscanf(value, "%15[a-z]:%lf", c.arrival_kind, &c.arrival_a);
+        } else if (strcmp(argv[i-1], "-seed") == 0) {
+            c.seed = strtoul(value, NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (c.processes == 0) usage(argv[0]);
+
+    mem_init();
+    struct job *jobs = generate(&c);
+
+    printf("{\n  \"config\": {\"processes\": %zu, \"len\": \"%s\", "
+           "\"mix\": \"%s\", \"arrival\": \"%s\", \"seed\": %u, "
+           "\"time_unit\": \"instructions\"},\n  \"results\": [\n",
+           c.processes, len_spec, mix_spec, arrival_spec, c.seed);
+    for (size_t p = 0; p < POLICY_COUNT; ++p) {
+        run_policy(policies[p], jobs, c.processes);
+        printf(p + 1 < POLICY_COUNT ? ",\n" : "\n");
+    }
+    printf("  ]\n}\n");
+
+    for (size_t i = 0; i < c.processes; ++i) free(jobs[i].code);
+    free(jobs);
+    return 0;
+}
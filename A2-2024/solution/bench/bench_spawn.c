@@ -0,0 +1,62 @@
+// Benchmark for starting external programs.
+//
+// fork() has to copy the page tables of the whole shell, so its cost grows
+// with the shell's memory, while posix_spawn (see launch.h) doesn't copy
+// anything. This grows the heap to a few sizes, touching every page so the
+// memory is really mapped, and times launching /bin/true and waiting for it
+// both ways. Only the posix_spawn column should stay flat.
+//
+// Build with `make bench` and run ./bench/bench_spawn [spawns [MiB...]].
+// The default is 200 spawns at 0, 16, 64, 256 and 1024 MiB of heap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include "../launch.h"
+#include "../timing.h"
+
+#define MIB (1024 * 1024)
+
+// Launch and reap the program `spawns` times; returns ns per spawn.
+static double time_spawns(pid_t (*launch_fn)(const struct launch *),
+                          const struct launch *launch, int spawns) {
+    uint64_t start = monotonic_ns();
+    for (int i = 0; i < spawns; ++i) {
+        pid_t pid = launch_fn(launch);
+        if (pid < 0) exit(EXIT_FAILURE);
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return (double)(monotonic_ns() - start) / spawns;
+}
+
+int main(int argc, char *argv[]) {
+    int spawns = argc > 1 ? atoi(argv[1]) : 200;
+    size_t default_sizes[] = {0, 16, 64, 256, 1024};
+    size_t count = argc > 2 ? (size_t)argc - 2 : sizeof(default_sizes) / sizeof(default_sizes[0]);
+
+    char *args[] = {"true", NULL};
+    struct launch launch = { .argv = args };
+
+    printf("%10s %16s %16s\n", "heap MiB", "fork us/spawn", "posix us/spawn");
+    char *heap = NULL;
+    for (size_t s = 0; s < count; ++s) {
+        size_t mib = argc > 2 ? strtoul(argv[s + 2], NULL, 10) : default_sizes[s];
+        free(heap);
+        heap = NULL;
+        if (mib) {
+            heap = malloc(mib * MIB);
+            if (!heap) {
+                printf("%10zu out of memory\n", mib);
+                break;
+            }
+            memset(heap, 1, mib * MIB);
+        }
+        double forked = time_spawns(launch_process_fork, &launch, spawns);
+        double spawned = time_spawns(launch_process, &launch, spawns);
+        printf("%10zu %16.1f %16.1f\n", mib, forked / 1000, spawned / 1000);
+    }
+    free(heap);
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "interpreter.h"
+#include "shell.h"
+#include "shellmemory.h"
+
+// The front end is tokenize_line, which already splits the line into
+// commands, looks up their builtins, and resolves the variables they use.
+// All that's left here is to pick an opcode for each command and to lay
+// out what it needs where run_bytecode can get at it without any work.
+
+// The opcode for a command. Only commands that run_command would run
+// without complaint get an opcode of their own; anything it would reject,
+// it still rejects, so the messages and error codes stay the same.
+static enum opcode choose_opcode(const struct instruction *in) {
+    if (!builtin_accepts(in->command, in->argc)) return OP_CALL;
+    switch (in->command) {
+    case CMD_SET:
+        return OP_SET;
+    case CMD_PRINT:
+        return OP_PRINT;
+    case CMD_ECHO:
+        return OP_ECHO;
+    default:
+        return OP_CALL;
+    }
+}
+
+static uint32_t op_symbol(size_t symbol) {
+    if (symbol == NO_SYMBOL) return OP_NO_SYMBOL;
+    assert(symbol < OP_NO_SYMBOL);
+    return (uint32_t)symbol;
+}
+
+struct bytecode *compile_line(const char *line) {
+    struct tokenized_line *tl = tokenize_line(line);
+    const char *text = tl->text;
+
+    size_t word_count = 0;
+    for (size_t i = 0; i < tl->count; ++i) {
+        if (choose_opcode(&tl->instructions[i]) == OP_CALL) {
+            word_count += tl->instructions[i].argc;
+        }
+    }
+
+    // The ops, then the word offsets, then the pool, which starts out as
+    // the words of the line.
+    size_t ops_size = (tl->count + 1) * sizeof(struct op);
+    size_t words_size = word_count * sizeof(uint16_t);
+    struct bytecode *code = malloc(sizeof(struct bytecode)
+                                   + ops_size + words_size + tl->text_size);
+    struct op *ops = (struct op *)(code + 1);
+    uint16_t *words = (uint16_t *)((char *)ops + ops_size);
+    char *pool = (char *)words + words_size;
+    memcpy(pool, text, tl->text_size);
+    code->count = tl->count;
+    code->ops = ops;
+    code->words = words;
+    code->pool = pool;
+
+    size_t next_word = 0;
+    for (size_t i = 0; i < tl->count; ++i) {
+        const struct instruction *in = &tl->instructions[i];
+        struct op *op = &ops[i];
+        op->opcode = choose_opcode(in);
+        op->command = in->command;
+        op->argc = in->argc;
+        op->operand = 0;
+        op->size = 0;
+        op->symbol = op_symbol(in->symbol);
+
+        switch (op->opcode) {
+        case OP_SET: {
+            // set joins its value's words with single spaces. They're
+            // already next to each other in the pool, with a NUL between
+            // each, so it's enough to turn those NULs into spaces.
+            size_t start = in->argv[2] - text;
+            size_t end = in->argv[in->argc - 1] - text;
+            for (size_t c = start; c < end; ++c) {
+                if (pool[c] == '\0') pool[c] = ' ';
+            }
+            op->operand = start;
+            break;
+        }
+        case OP_ECHO:
+            op->operand = in->argv[1] - text;
+            break;
+        case OP_CALL:
+            op->operand = next_word;
+            for (int w = 0; w < in->argc; ++w) {
+                words[next_word++] = in->argv[w] - text;
+            }
+            if (in->argc) {
+                const char *last = in->argv[in->argc - 1];
+                op->size = last + strlen(last) + 1 - in->argv[0];
+            }
+            break;
+        }
+    }
+    ops[tl->count] = (struct op){ .opcode = OP_END, .symbol = OP_NO_SYMBOL };
+
+    free(tl);
+    return code;
+}
+
+// Each op jumps straight to the code for the next one. With GCC and Clang
+// that is a computed goto through a table of labels, so every op has its
+// own indirect branch, which the branch predictor can learn separately;
+// elsewhere, it goes back through a switch.
+#ifdef __GNUC__
+#define NEXT() goto *dispatch[op->opcode]
+#else
+#define NEXT() goto next
+#endif
+
+int run_bytecode(const struct bytecode *code) {
+#ifdef __GNUC__
+    static const void *const dispatch[OP_COUNT] = {
+        [OP_SET] = &&op_set,
+        [OP_PRINT] = &&op_print,
+        [OP_ECHO] = &&op_echo,
+        [OP_CALL] = &&op_call,
+        [OP_END] = &&op_end,
+    };
+#endif
+    const struct op *op = code->ops;
+    int errorCode = 0;
+    // The builtins behind OP_CALL may edit their words (exec strips the
+    // suffixes off script names), but the line may well be run again, so
+    // they get a copy.
+    char text[MAX_USER_INPUT];
+    char *argv[MAX_USER_INPUT / 2 + 1];
+
+    NEXT();
+#ifndef __GNUC__
+next:
+    switch (op->opcode) {
+    case OP_SET: goto op_set;
+    case OP_PRINT: goto op_print;
+    case OP_ECHO: goto op_echo;
+    case OP_CALL: goto op_call;
+    default: goto op_end;
+    }
+#endif
+
+op_set:
+    // This is all that set does, once the value is joined and the
+    // variable interned. set and print always intern their variable.
+    assert(op->symbol != OP_NO_SYMBOL);
+    mem_set_symbol(op->symbol, code->pool + op->operand);
+    errorCode = 0;
+    op++;
+    NEXT();
+
+op_print:
+    // print only needs the name if there's no symbol, and it always has one.
+    assert(op->symbol != OP_NO_SYMBOL);
+    errorCode = print(NULL, op->symbol);
+    op++;
+    NEXT();
+
+op_echo:
+    // echo doesn't touch its word, so it can have the pool's.
+    errorCode = echo((char *)code->pool + op->operand,
+                     op->symbol == OP_NO_SYMBOL ? NO_SYMBOL : op->symbol);
+    op++;
+    NEXT();
+
+op_call: {
+    const uint16_t *words = code->words + op->operand;
+    if (op->argc) {
+        memcpy(text, code->pool + words[0], op->size);
+    }
+    for (int w = 0; w < op->argc; ++w) {
+        argv[w] = text + (words[w] - words[0]);
+    }
+    errorCode = run_command(op->command, argv, op->argc,
+                            op->symbol == OP_NO_SYMBOL ? NO_SYMBOL : op->symbol);
+    op++;
+    NEXT();
+}
+
+op_end:
+    return errorCode;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include "command.h"
+
+// Script lines are compiled, when their script is read (see script.h), into a
+// short program for a small virtual machine, so that running them is a
+// jump from one op to the next rather than a trip through the interpreter.
+//
+// The builtins that scripts mostly consist of (set, print and echo) get an
+// opcode of their own, with their arguments already checked, joined, and
+// resolved to symbols (see shellmemory.h). Everything else, including
+// commands with the wrong number of words, is an OP_CALL, which hands the
+// words to run_command exactly as parseInput would have, errors and all.
+
+enum opcode {
+    OP_SET,      // set the variable to the string
+    OP_PRINT,    // print the variable
+    OP_ECHO,     // echo the word, which may be a variable
+    OP_CALL,     // run_command with the words
+    OP_END,      // the end of the line
+    OP_COUNT
+};
+
+#define OP_NO_SYMBOL UINT32_MAX
+
+// One command of a line. Offsets are into the line's pool of strings,
+// which is no longer than the line, so 16 bits are plenty.
+struct op {
+    uint8_t opcode;
+    uint8_t command; // an enum command, for OP_CALL
+    uint16_t argc;   // for OP_CALL
+    // OP_SET and OP_ECHO: the offset of the string.
+    // OP_CALL: the index of the first word in the line's word offsets.
+    uint16_t operand;
+    uint16_t size;   // OP_CALL: the bytes taken by the words, NULs included
+    uint32_t symbol; // the variable, or OP_NO_SYMBOL
+};
+
+struct bytecode {
+    size_t count; // the ops, not counting the OP_END after them
+    const struct op *ops;
+    const uint16_t *words; // the offset of each OP_CALL word in the pool
+    const char *pool;
+};
+
+// Compile the line, which is split into commands the same way parseInput
+// would split it. Everything is in one allocation, so free() the result.
+struct bytecode *compile_line(const char *line);
+// Run the compiled line. Returns the error code of its last command, as
+// parseInput would.
+int run_bytecode(const struct bytecode *code);
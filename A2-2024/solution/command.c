@@ -0,0 +1,111 @@
+#include <ctype.h> // isspace
+#include <string.h>
+#include "command.h"
+
+// Every builtin: its command, its name, and the first and last characters
+// of its name, spelled out so that its slot in the table below is a
+// constant. CMD_UNKNOWN has no name.
+#define BUILTINS(X) \
+    X(CMD_HELP,     "help",     'h', 'p') \
+    X(CMD_QUIT,     "quit",     'q', 't') \
+    X(CMD_SET,      "set",      's', 't') \
+    X(CMD_PRINT,    "print",    'p', 't') \
+    X(CMD_ECHO,     "echo",     'e', 'o') \
+    X(CMD_MY_LS,    "my_ls",    'm', 's') \
+    X(CMD_MY_MKDIR, "my_mkdir", 'm', 'r') \
+    X(CMD_MY_TOUCH, "my_touch", 'm', 'h') \
+    X(CMD_MY_CD,    "my_cd",    'm', 'd') \
+    X(CMD_RUN,      "run",      'r', 'n') \
+    X(CMD_EXEC,     "exec",     'e', 'c') \
+    X(CMD_SPAWN,    "spawn",    's', 'n') \
+    X(CMD_PS,       "ps",       'p', 's') \
+    X(CMD_TOP,      "top",      't', 'p') \
+    X(CMD_JOBS,     "jobs",     'j', 's') \
+    X(CMD_WAIT,     "wait",     'w', 't')
+
+// Names are looked up in a perfect hash table: a name's slot depends only
+// on its first and last characters, and no two builtins share a slot, so
+// a lookup is one hash, one load, and one comparison against the only
+// builtin the name could be, however many builtins there are. The hash
+// was picked by trying small multipliers until the builtins didn't
+// collide; if a new builtin does, the _Static_assert below says so, and
+// COMMAND_HASH needs new multipliers (or a bigger table).
+#define COMMAND_SLOTS 32
+#define COMMAND_HASH(first, last) \
+    (((unsigned char)(first) + 2u * (unsigned char)(last)) % COMMAND_SLOTS)
+
+struct command_slot {
+    const char *name; // NULL if no builtin hashes here
+    unsigned char len;
+    unsigned char command;
+};
+
+static const struct command_slot command_slots[COMMAND_SLOTS] = {
+#define SLOT(cmd, name, first, last) \
+    [COMMAND_HASH(first, last)] = { name, sizeof(name) - 1, cmd },
+    BUILTINS(SLOT)
+#undef SLOT
+};
+
+// If two builtins had the same slot, one would overwrite the other above.
+// With a bit per slot, the sum of the builtins' bits only equals their OR
+// if no two of them share a bit.
+#define SLOT_BIT_OR(cmd, name, first, last) | (1ull << COMMAND_HASH(first, last))
+#define SLOT_BIT_SUM(cmd, name, first, last) + (1ull << COMMAND_HASH(first, last))
+_Static_assert((0 BUILTINS(SLOT_BIT_OR)) == (0 BUILTINS(SLOT_BIT_SUM)),
+               "two builtins hash to the same slot; pick a new COMMAND_HASH");
+
+// The builtin named by the len characters at name.
+static enum command command_named_len(const char *name, size_t len) {
+    if (len == 0) return CMD_UNKNOWN;
+    const struct command_slot *slot = &command_slots[COMMAND_HASH(name[0], name[len - 1])];
+    if (slot->name && slot->len == len && memcmp(slot->name, name, len) == 0) {
+        return slot->command;
+    }
+    return CMD_UNKNOWN;
+}
+
+enum command command_named(const char *name) {
+    return command_named_len(name, strlen(name));
+}
+
+enum command classify_command(const char *line) {
+    // Find the first word the same way parseInput does.
+    while (isspace((unsigned char)*line)) line++;
+    return command_named_len(line, strcspn(line, " \t\r\n\v\f;"));
+}
+
+// Priors, in nanoseconds. These only need to be the right order of
+// magnitude; measurements take over quickly.
+#define COST_PRIOR_CHEAP      2000.0
+#define COST_PRIOR_FILESYSTEM 20000.0
+#define COST_PRIOR_LAUNCH     1000000.0
+
+static double command_costs[CMD_COUNT] = {
+    [CMD_HELP]     = COST_PRIOR_CHEAP,
+    [CMD_QUIT]     = COST_PRIOR_CHEAP,
+    [CMD_SET]      = COST_PRIOR_CHEAP,
+    [CMD_PRINT]    = COST_PRIOR_CHEAP,
+    [CMD_ECHO]     = COST_PRIOR_CHEAP,
+    [CMD_MY_LS]    = COST_PRIOR_FILESYSTEM,
+    [CMD_MY_MKDIR] = COST_PRIOR_FILESYSTEM,
+    [CMD_MY_TOUCH] = COST_PRIOR_FILESYSTEM,
+    [CMD_MY_CD]    = COST_PRIOR_FILESYSTEM,
+    [CMD_RUN]      = COST_PRIOR_LAUNCH,
+    [CMD_EXEC]     = COST_PRIOR_LAUNCH,
+    [CMD_SPAWN]    = COST_PRIOR_LAUNCH,
+    [CMD_PS]       = COST_PRIOR_CHEAP,
+    [CMD_TOP]      = COST_PRIOR_CHEAP,
+    [CMD_JOBS]     = COST_PRIOR_CHEAP,
+    // In a script, wait blocks the process rather than taking any time.
+    [CMD_WAIT]     = COST_PRIOR_CHEAP,
+    [CMD_UNKNOWN]  = COST_PRIOR_CHEAP,
+};
+
+double command_cost(enum command cmd) {
+    return command_costs[cmd];
+}
+
+void record_command_cost(enum command cmd, uint64_t ns) {
+    command_costs[cmd] += COST_EMA_ALPHA * ((double)ns - command_costs[cmd]);
+}
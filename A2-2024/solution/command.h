@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+// Every builtin the interpreter knows, so that per-command information can
+// be kept in arrays indexed by command. CMD_UNKNOWN covers blank lines and
+// anything the interpreter would reject as an unknown command.
+enum command {
+    CMD_HELP,
+    CMD_QUIT,
+    CMD_SET,
+    CMD_PRINT,
+    CMD_ECHO,
+    CMD_MY_LS,
+    CMD_MY_MKDIR,
+    CMD_MY_TOUCH,
+    CMD_MY_CD,
+    CMD_RUN,
+    CMD_EXEC,
+    CMD_SPAWN,
+    CMD_PS,
+    CMD_TOP,
+    CMD_JOBS,
+    CMD_WAIT,
+    CMD_UNKNOWN,
+    CMD_COUNT
+};
+
+// Which builtin has the given name.
+enum command command_named(const char *name);
+// Which builtin the given line of script starts with.
+// For a ';' chain, only the first command counts.
+enum command classify_command(const char *line);
+
+// The cost model used by predicted-cost scheduling.
+// Every line that SJFP or EDF runs is timed, and the time is folded into an
+// exponential moving average for the command that line starts with.
+// Before anything has been measured, each command has a rough prior:
+// printing is cheap, touching the filesystem is dearer, and starting
+// scripts or processes is dearest.
+
+// The estimated cost of one line starting with cmd, in nanoseconds.
+double command_cost(enum command cmd);
+// Fold a measured run time for one line starting with cmd into its estimate.
+void record_command_cost(enum command cmd, uint64_t ns);
+
+// The weight of a new measurement in the moving average.
+#define COST_EMA_ALPHA 0.25
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h> 
 #include <ctype.h> // tolower, isdigit
+#include <limits.h> // INT_MAX
 #include <dirent.h> // scandir
 #include <unistd.h> // chdir
 #include <sys/stat.h> // mkdir
@@ -16,17 +17,22 @@
 #include <sys/types.h> // pid_t
 #include <sys/wait.h> // waitpid
 
+#include "bytecode.h"
+#include "command.h"
+#include "interpreter.h"
+#include "jobs.h"
 #include "pcb.h"
 #include "queue.h"
 #include "schedule_policy.h"
+#include "ps.h"
+#include "scheduler.h"
 #include "shellmemory.h"
 #include "shell.h"
+#include "timing.h"
 
 #define true 1
 #define false 0
 
-#define MAX_ARGS_SIZE 7
-
 int badcommand() {
     printf("Unknown Command\n");
     return 1;
@@ -55,24 +61,22 @@ int badcommandCd() {
 
 int help();
 int quit();
-int set(char *var, char *value[], int value_size);
-int print(char *var);
-int echo(char *tok);
+int set(char *var, size_t symbol, char *value[], int value_size);
+int print(char *var, size_t symbol);
+int echo(char *tok, size_t symbol);
 int ls();
-int my_mkdir(char *name);
+int my_mkdir(char *name, size_t symbol);
 int touch(char *path);
 int cd(char *path);
 int run(char *script);
 int my_exec(char *args[], int args_size);
 int spawn(char *argv[], int args_size);
+int my_wait(char *id);
 
-void runSchedule(struct queue *q, const struct schedule_policy *p);
 int badcommandFileDoesNotExist();
 
 // Interpret commands and their arguments
-int interpreter(char *command_args[], int args_size) {
-    int i;
-
+int interpreter(char *command_args[], int args_size, size_t symbol) {
     // these bits of debug output were very helpful for debugging
     // the changes we made to the parser!
     debug("#args: %d\n", args_size);
@@ -82,73 +86,93 @@ int interpreter(char *command_args[], int args_size) {
     }
 #endif
 
+    enum command cmd = args_size < 1 ? CMD_UNKNOWN : command_named(command_args[0]);
+    return run_command(cmd, command_args, args_size, symbol);
+}
+
+// Each builtin's handler takes the whole command, name and all, so that
+// they can all go in one table.
+static int run_help(char *args[], int args_size, size_t symbol) { return help(); }
+static int run_quit(char *args[], int args_size, size_t symbol) { return quit(); }
+static int run_set(char *args[], int args_size, size_t symbol) {
+    return set(args[1], symbol, &args[2], args_size - 2);
+}
+static int run_print(char *args[], int args_size, size_t symbol) { return print(args[1], symbol); }
+static int run_echo(char *args[], int args_size, size_t symbol) { return echo(args[1], symbol); }
+static int run_ls(char *args[], int args_size, size_t symbol) { return ls(); }
+static int run_mkdir(char *args[], int args_size, size_t symbol) { return my_mkdir(args[1], symbol); }
+static int run_touch(char *args[], int args_size, size_t symbol) { return touch(args[1]); }
+static int run_cd(char *args[], int args_size, size_t symbol) { return cd(args[1]); }
+static int run_run(char *args[], int args_size, size_t symbol) { return run(args[1]); }
+static int run_exec(char *args[], int args_size, size_t symbol) {
+    return my_exec(&args[1], args_size - 1);
+}
+static int run_spawn(char *args[], int args_size, size_t symbol) {
+    return spawn(&args[1], args_size - 1);
+}
+static int run_jobs(char *args[], int args_size, size_t symbol) { return jobs(); }
+static int run_wait(char *args[], int args_size, size_t symbol) {
+    return my_wait(args_size == 2 ? args[1] : NULL);
+}
+static int run_ps(char *args[], int args_size, size_t symbol) { return ps(); }
+static int run_top(char *args[], int args_size, size_t symbol) { return top(); }
+
+// How many words each builtin takes, counting its name, and its handler.
+// Indexed by enum command; CMD_UNKNOWN has no handler, so it's always a
+// bad command.
+struct builtin {
+    int min_args, max_args;
+    int (*run)(char *args[], int args_size, size_t symbol);
+};
+
+static const struct builtin builtins[CMD_COUNT] = {
+    [CMD_HELP]     = { 1, 1, run_help },
+    [CMD_QUIT]     = { 1, 1, run_quit },
+    [CMD_SET]      = { 3, 7, run_set },
+    [CMD_PRINT]    = { 2, 2, run_print },
+    [CMD_ECHO]     = { 2, 2, run_echo },
+    [CMD_MY_LS]    = { 1, 1, run_ls },
+    [CMD_MY_MKDIR] = { 2, 2, run_mkdir },
+    [CMD_MY_TOUCH] = { 2, 2, run_touch },
+    [CMD_MY_CD]    = { 2, 2, run_cd },
+    [CMD_RUN]      = { 2, 2, run_run },
+    // exec takes any number of scripts, so it's exempt from MAX_ARGS_SIZE.
+    [CMD_EXEC]     = { 2, INT_MAX, run_exec },
+    [CMD_SPAWN]    = { 2, MAX_ARGS_SIZE, run_spawn },
+    [CMD_JOBS]     = { 1, 1, run_jobs },
+    [CMD_WAIT]     = { 1, 2, run_wait },
+    [CMD_PS]       = { 1, 1, run_ps },
+    [CMD_TOP]      = { 1, 1, run_top },
+};
+
+int builtin_accepts(enum command cmd, int args_size) {
+    const struct builtin *builtin = &builtins[cmd];
+    return builtin->run && args_size >= builtin->min_args && args_size <= builtin->max_args;
+}
+
+// Lines of a script were already split into words, and their commands
+// looked up, when they were stored (see compile_line in bytecode.c), so
+// the commands that aren't compiled any further come straight here instead
+// of through interpreter.
+int run_command(enum command cmd, char *command_args[], int args_size, size_t symbol) {
+    int i;
+
     if (args_size < 1) { 
         // this is only even possible because the spec says we shouldn't
         // just ignore blank lines. In a real implementation,
         // we would ignore them. (see parseInput in shell.c)
         return badcommand();
     }
-    if (args_size > MAX_ARGS_SIZE) { // this is totally possible though
-        return badcommandTooLong();
+    if (args_size > MAX_ARGS_SIZE && builtins[cmd].max_args <= MAX_ARGS_SIZE) {
+        return badcommandTooLong(); // this is totally possible though
     }
 
     for (i = 0; i < args_size; i++) { // terminate args at newlines
         command_args[i][strcspn(command_args[i], "\r\n")] = 0;
     }
 
-    if (strcmp(command_args[0], "help") == 0){
-        //help
-        if (args_size != 1) return badcommand();
-        return help();
-    
-    } else if (strcmp(command_args[0], "quit") == 0) {
-        //quit
-        if (args_size != 1) return badcommand();
-        return quit();
-
-    } else if (strcmp(command_args[0], "set") == 0) {
-        //set
-        if (args_size < 3) return badcommand();
-        if (args_size > 7) return badcommand();	
-        return set(command_args[1], &command_args[2], args_size-2);
-    
-    } else if (strcmp(command_args[0], "print") == 0) {
-        if (args_size != 2) return badcommand();
-        return print(command_args[1]);
-
-    } else if (strcmp(command_args[0], "echo") == 0) {
-        if (args_size != 2) return badcommand();
-        return echo(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_ls") == 0) {
-        if (args_size != 1) return badcommand();
-        return ls();
-
-    } else if (strcmp(command_args[0], "my_mkdir") == 0) {
-        if (args_size != 2) return badcommand();
-        return my_mkdir(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_touch") == 0) {
-        if (args_size != 2) return badcommand();
-        return touch(command_args[1]);
-
-    } else if (strcmp(command_args[0], "my_cd") == 0) {
-        if (args_size != 2) return badcommand();
-        return cd(command_args[1]);
-
-    } else if (strcmp(command_args[0], "run") == 0) {
-        if (args_size != 2) return badcommand();
-        return run(command_args[1]);
-    
-    } else if (strcmp(command_args[0], "exec") == 0) {
-        if (args_size < 2) return badcommand();
-        return my_exec(&command_args[1], args_size - 1);
-
-    } else if (strcmp(command_args[0], "spawn") == 0) {
-        if (args_size < 2) return badcommand();
-        return spawn(command_args+1, args_size-1);
-
-    } else return badcommand();
+    if (!builtin_accepts(cmd, args_size)) return badcommand();
+    return builtins[cmd].run(command_args, args_size, symbol);
 }
 
 int help() {
@@ -169,7 +193,13 @@ int quit() {
     exit(0);
 }
 
-int set(char *var, char *value[], int value_size) {
+// The value of the variable a builtin was given: through its symbol, if the
+// line was resolved when its script was read, or else by name.
+static const char *view_variable(const char *var, size_t symbol) {
+    return symbol != NO_SYMBOL ? mem_view_symbol(symbol) : mem_view_value(var);
+}
+
+int set(char *var, size_t symbol, char *value[], int value_size) {
     // precondition: value_size in [1,5]
     char buffer[MAX_USER_INPUT];
     char *space = " ";
@@ -180,39 +210,35 @@ int set(char *var, char *value[], int value_size) {
         strcat(buffer, value[i]);
     }
 
-    mem_set_value(var, buffer);
+    if (symbol == NO_SYMBOL) symbol = mem_intern(var);
+    mem_set_symbol(symbol, buffer);
 
     return 0;
 }
 
-int print(char *var) {
-    char *value = mem_get_value(var);
+int print(char *var, size_t symbol) {
+    const char *value = view_variable(var, symbol);
     if (value) {
         printf("%s\n", value);
-        free(value);
     } else {
         printf("Variable does not exist\n");
     }
     return 0;
 }
 
-int echo(char *tok) {
-    int must_free = 0;
+int echo(char *tok, size_t symbol) {
+    const char *text = tok;
     // is it a var?
     if (tok[0] == '$') {
-        tok++; // advance pointer, so that tok is now the stuff after '$'
-        tok = mem_get_value(tok);
-        if (tok == NULL) {
-            tok = ""; // must use empty string, can't pass NULL to printf
-        } else {
-            must_free = 1;
+        // skip the '$'. We only read the value before anything else can
+        // set a variable, so a view will do, and there's nothing to free.
+        text = view_variable(tok + 1, symbol);
+        if (text == NULL) {
+            text = ""; // must use empty string, can't pass NULL to printf
         }
     }
 
-    printf("%s\n", tok);
-
-    // memory management technically optional for this assignment
-    if (must_free) free(tok);
+    printf("%s\n", text);
 
     return 0;
 }
@@ -300,31 +326,26 @@ int ls() {
     return 0;
 }
 
-int str_isalphanum(char *name) {
+int str_isalphanum(const char *name) {
     for (char c = *name; c != '\0'; c = *++name) {
         if (!(isdigit(c) || isalpha(c))) return 0;
     }
     return 1;
 }
 
-int my_mkdir(char *name) {
-    int must_free = 0;
+int my_mkdir(char *arg, size_t symbol) {
+    const char *name = arg;
 
     debug("my_mkdir: ->%s<-\n", name);
 
     if (name[0] == '$') {
-        ++name;
-        // lookup name
-        name = mem_get_value(name);
+        // lookup name. The view stays good until a variable is set,
+        // which can't happen before we're done with it.
+        name = view_variable(arg + 1, symbol);
         debug("  lookup: %s\n", name ? name : "(NULL)");
-        if (name) {
-            // name exists, should free whatever we got
-            must_free = 1;
-        }
     }
     if (!name || !str_isalphanum(name)) {
         // either name doesn't exist, or isn't valid, error.
-        if (must_free) free(name);
         return badcommandMkdir();
     }
     // at this point name is definitely OK
@@ -340,7 +361,6 @@ int my_mkdir(char *name) {
         perror("Something went wrong in my_mkdir");
     }
 
-    if (must_free) free(name);
     return 0;
 }
 
@@ -374,35 +394,45 @@ int cd(char *path) {
     return 0;
 }
 
-void runSchedule(struct queue *q, const struct schedule_policy *policy) {
-    struct PCB *next_pcb = policy->dequeue(q);
-    while (next_pcb) {
-        next_pcb = policy->run_pcb(next_pcb);
-        if (next_pcb) policy->enqueue(q, next_pcb);
-        next_pcb = policy->dequeue(q);
+// Execute the next instruction of pcb.
+// If timed, the line is timed, to train the cost model that SJFP and EDF
+// use. Two clock reads cost about as much as a short line itself, so
+// nothing else pays for them.
+static void run_next_instruction(struct PCB *pcb, int timed) {
+    size_t instr = pcb_next_instruction(pcb);
+    if (!timed) {
+        run_bytecode(get_line_code(instr));
+        return;
     }
+
+    uint64_t start = monotonic_ns();
+    run_bytecode(get_line_code(instr));
+    record_command_cost(get_line_command(instr), monotonic_ns() - start);
 }
 
-struct PCB *run_pcb_to_completion(struct PCB *pcb) {
-    while (pcb_has_next_instruction(pcb)) {
-        size_t instr = pcb_next_instruction(pcb);
-        parseInput(get_line(instr));
+struct PCB *run_pcb_to_completion(struct PCB *pcb, int timed) {
+    while (pcb_has_next_instruction(pcb) && !pcb->waiting_for_job) {
+        run_next_instruction(pcb, timed);
     }
+    // A process that blocked isn't done, even if that was its last line:
+    // it still has to wait.
+    if (pcb->waiting_for_job) return pcb;
     free_pcb(pcb);
     return NULL;
 }
 
-struct PCB *run_pcb_for_n_steps(struct PCB *pcb, size_t n) {
+struct PCB *run_pcb_for_n_steps(struct PCB *pcb, size_t n, int timed) {
     debug("run n steps: n is %ld\n", n);
-    for (; n && pcb_has_next_instruction(pcb); --n) {
-        parseInput(get_line(pcb_next_instruction(pcb)));
+    for (; n && pcb_has_next_instruction(pcb) && !pcb->waiting_for_job; --n) {
+        run_next_instruction(pcb, timed);
     }
     debug("run n steps: looped to %ld\n", n);
     // The loop runs until either we've done n steps or the pcb is out of
     // instructions,  whichever happens first. But they might also happen
     // at the same time, in which case we should still clean up.
     // So check if there are more instructions, not the value of n.
-    if (pcb_has_next_instruction(pcb)) {
+    // The process might also have blocked, and then it isn't done yet.
+    if (pcb_has_next_instruction(pcb) || pcb->waiting_for_job) {
         return pcb;
     } else {
         free_pcb(pcb);
@@ -415,21 +445,34 @@ int run(char *script) {
     return my_exec(args, 2);
 }
 
-// These are all global variables because they are not local to any particular
+// A script passed to exec may carry suffixes, as in `exec prog1@50:3 CFS`:
+//   :weight    its share of the interpreter (CFS weight, or tickets)
+//   @deadline  milliseconds from now by which it must finish (EDF)
+// If arg ends with the given mark followed by digits, remove that suffix
+// (in place), store the number in *value and return 1. Otherwise return 0.
+// Only an all-digit suffix counts, so a file that really has a ':' or '@'
+// in its name can still be run.
+static int split_script_suffix(char *arg, char mark, size_t *value) {
+    char *sep = strrchr(arg, mark);
+    if (!sep || sep == arg || sep[1] == '\0') return 0;
+    for (char *c = sep + 1; *c; ++c) {
+        if (!isdigit(*c)) return 0;
+    }
+    *value = strtoul(sep + 1, NULL, 10);
+    *sep = '\0';
+    return 1;
+}
+
+// These are global variables because they are not local to any particular
 // call to exec. Once we go into background or into MT mode,
 // the behavior of future calls is affected.
-// Those calls also need to be able to see the existing queue.
 // They could be defined `static` inside my_exec as well, but defining them
 // outside allows the possibility for other functions to also care about
 // the multithreaded/background state. For example, the `quit` function cares
 // about the multithreaded state.
-// Despite the top-level availability of these variables, global state is
-// rather confusing to work with. So functions like runSchedule() above
-// still take these values as arguments so they're easier to track.
+// The schedule itself lives in scheduler.c: every exec adds a group there.
 static int multithreaded = false;
 static int background = false;
-static struct queue *q = NULL;
-static const struct schedule_policy *policy = NULL;
 
 int my_exec(char *args[], int args_size) {
     // Two inputs is the minimum. This should be checked above, but sanity:
@@ -458,7 +501,18 @@ int my_exec(char *args[], int args_size) {
 
 
     // We check from the end, so we have to check in reverse order.
-    // Look for MT first.
+    // SIM<n> goes after everything else: `exec P1 P2 P3 RR SIM4` runs the
+    // scripts on 4 simulated CPUs instead of the shell's one interpreter
+    // (see run_group_simulated), to see how a policy would scale.
+    size_t sim_cpus = 0;
+    char *last = args[args_size-1];
+    if (args_size > 2 && strncmp(last, "SIM", 3) == 0 && last[3] != '\0'
+            && strspn(last + 3, "0123456789") == strlen(last + 3)) {
+        sim_cpus = strtoul(last + 3, NULL, 10);
+        if (sim_cpus == 0) return badcommand();
+        args_size--;
+    }
+    // Look for MT next.
     if (strcmp(args[args_size-1], "MT") == 0) {
         // TODO: if multithreaded was previously false, call function
         // to initialize multithreaded scheduler here.
@@ -472,60 +526,77 @@ int my_exec(char *args[], int args_size) {
         args_size--; // ditto
     }
     // At this point, there must be at least two arguments;
-    // a filename, and a policy. Similarly there are at most 4.
+    // a filename, and a policy. There used to be at most 3 scripts, but
+    // the process table grows as needed, so there's no upper limit now.
     // With the optional # and MT, it was harder
     // to tell that we were given well-formed input. But now we can check.
     // (It was safe to check for # and MT because we know there were at
     // least two arguments at the top, so decrementing args_size twice
     // was perfectly fine.)
-    if (args_size < 2 || args_size > 4) {
+    if (args_size < 2) {
         return badcommand();
     }
+    // A simulated run takes over the interpreter until it's done, so it
+    // can't share it with the shell input or with other groups.
+    if (sim_cpus && (background || multithreaded)) {
+        printf("Bad command: SIM can't be combined with # or MT\n");
+        return 1;
+    }
     // Now the last argument is the policy name.
     char *policy_name = args[args_size-1];
     args_size--;
     // Now the args,args_size array describes exactly the filenames.
+    // The policy may carry the weight of the whole group, as in `RR*3`:
+    // this group then gets three turns for every turn of a weight-1 group.
+    size_t group_weight;
+    if (!split_script_suffix(policy_name, '*', &group_weight)) {
+        group_weight = 1;
+    }
     // We know the policy name now, so retrieve the actual policy.
-    policy = get_policy(policy_name);
-    if (!policy) {
+    struct schedule_policy policy;
+    if (get_policy(policy_name, &policy)) {
         printf("Bad command: unknown scheduling policy\n");
         return 1;
     }
 
-    if (!background_exec) {
-        // In this case, we're a top-level exec call. We might be entering
-        // background mode though. In either case, we should reset the
-        // linememory allocator.
-        reset_linememory_allocator();
-        // We also need to allocate a queue to use.
-        // We own this, so we have to be sure to free it later!
-        assert(!q);
-        q = alloc_queue();
-    } else {
-        // In this case, we're an exec call originating from the background.
-        // Ensure that a queue exists.
-        assert(q);
-    }
+    // Every exec gets its own group, so it runs with its own policy even
+    // if other groups are already running. We own the group until it's
+    // added to the scheduler, so we have to be sure to free it on errors!
+    struct sched_group *group = alloc_group(&policy, group_weight);
 
-    // Create a filename for each process, in order, and enqueue them.
-    // We are allocating PCBs, but enqueue transfers ownership of the PCB
-    // to the queue, so we're not responsible for freeing these.
+    // Deadlines are relative to when exec was called.
+    uint64_t exec_start = monotonic_ns();
+
+    // Create a filename for each process, in order, and submit them.
+    // We are allocating PCBs, but submitting transfers ownership of the PCB
+    // to the group, so we're not responsible for freeing these.
+    // If shellmemory is full, the process waits in the group to be admitted
+    // once others exit, so big batches don't fail, they just queue up.
     for (int n = 0; n < args_size; ++n) {
         // Two scripts have the same filename ==> error
         // ---------------------------------------------
         // We check if two scripts have the same filename by scanning the
-        // existing queue. We do this because we know assignment 3 is about
-        // memory management and it's likely we're being told to error in
-        // assignment 2 so that in assignment 3 we can implement memory
-        // sharing. Since it's not tested, it doesn't really matter what we do.
+        // queues of every group, and of this one. We do this because we know
+        // assignment 3 is about memory management and it's likely we're
+        // being told to error in assignment 2 so that in assignment 3 we can
+        // implement memory sharing. Since it's not tested, it doesn't really
+        // matter what we do.
         // We're going to assume that for this check, 'recursive exec'
         // and multithreading are not involved. This guarantees that all
-        // scheduled processes are visible on the queue while we check
+        // scheduled processes are visible on the queues while we check
         // file names. That assumption will hold for assignment 3.
         // Obviously it doesn't hold in a real OS!
         // Having a proper process table, rather than only a schedule,
         // would solve that problem.
-        if (program_already_scheduled(q, args[n])) {
+
+        // The weight comes last, so strip it first.
+        size_t weight, deadline_ms;
+        if (!split_script_suffix(args[n], ':', &weight) || weight == 0) {
+            weight = 1;
+        }
+        int has_deadline = split_script_suffix(args[n], '@', &deadline_ms);
+        if (program_scheduled_in_group(group, args[n])
+                || program_scheduled_in_any_group(args[n])) {
             printf("Bad command: script named %s already scheduled\n", args[n]);
             goto cleanup;
         }
@@ -534,7 +605,17 @@ int my_exec(char *args[], int args_size) {
             printf("Failed to create process\n");
             goto cleanup;
         }
-        policy->enqueue(q, pcb);
+        pcb->weight = weight;
+        if (has_deadline) {
+            pcb->deadline = exec_start + (uint64_t)deadline_ms * 1000000;
+        }
+        submit_process(group, pcb);
+    }
+
+    // Policies with an admission check get to look over the new schedule,
+    // e.g. EDF warns about deadlines it can already tell will be missed.
+    if (group->policy.check_admission) {
+        group->policy.check_admission(group->q);
     }
 
     if (background && !background_exec) {
@@ -542,53 +623,54 @@ int my_exec(char *args[], int args_size) {
         // exec call. Therefore, we're entering background mode.
 
         // add the rest of the input to a new program:
+        // The rest of the batch can't wait to be admitted: the scripts
+        // might be waiting on it. So it has to fit now.
+        release_batch_input();
         struct PCB *pcb = create_process_from_FILE(stdin);
+        if (pcb && pcb_load(pcb)) {
+            free_pcb(pcb);
+            pcb = NULL;
+        }
         if (!pcb) {
             printf("Failed to create STDIN process\n");
             goto cleanup;
         }
-        // Ensure that this is scheduled first!
-        policy->enqueue_ignoring_priority(q, pcb);
+        // Ensure that this is scheduled first! The shell input belongs to
+        // the first group, so later background execs join in behind it.
+        group->policy.enqueue_ignoring_priority(group->q, pcb);
     }
 
+    if (sim_cpus) {
+        run_group_simulated(group, sim_cpus);
+        return 0;
+    }
+
+    add_group(group);
+
     if (!background_exec) {
         // We should only start the scheduler if we are a top-level exec call.
-        // If we are not top-level, it's already running!
-        runSchedule(q, policy);
+        // If we are not top-level, it's already running, and will pick
+        // up the new group on its next round.
+        run_groups();
         // After the schedule completes, if we were given the # argument,
         // the exec should never 'return'. When it's done, so is the batch
         // mode script we are running. Therefore, if we get here without
         // invoking quit, we should quit.
         if (background) return quit();
-
-        // If we are a top-level exec call,
-        // we can now release the queue we allocated for scheduling.
-top_level_cleanup:
-        free_queue(q);
-        q = NULL;
-        policy = NULL;
     }
-
-background_cleanup:
     return 0;
 
-    // This is an unfortunately common error-handling pattern in C.
-    // Without try-catch-finally as a language feature, there isn't a cleaner
-    // way to handle certain kinds of errors.
-    // This is essentially implementing a 'finally' block that guarantees
-    // the queue allocated for top-level exec calls is freed.
-    // Note that, if this is not a top-level exec call, we will not free
-    // anything at all. That means this program might not behave as expected:
+    // If anything goes wrong before the group is added, none of it has run
+    // yet, so throw the whole group away, including the PCBs that were
+    // already made. For example:
     //   exec P1 P2 #
     //   exec P3 P1
     //   quit
-    // The schedule will end up containing P1, P2, _and_ P3, because the
-    // background exec will refuse to allocate a second PCB for P1 but
-    // will not de-allocate the PCB it already made for P3.
-    // We are told we may handle corner cases however we like, so that's fine.
+    // The background exec refuses to make a second PCB for P1, and frees
+    // the one it made for P3, so the schedule is still just P1 and P2.
 cleanup:
-    if (background_exec) goto background_cleanup;
-    else                 goto top_level_cleanup;
+    free_group(group);
+    return 0;
 }
 
 int spawn(char *argv[], int args_size) {
@@ -598,31 +680,79 @@ int spawn(char *argv[], int args_size) {
     // very bad separation of concerns. Instead we just take the time to
     // copy it here, into an array that we are certain, locally, has space.
     char *args[MAX_ARGS_SIZE] = {0};
-    // first arg is the thing to execute, it's _also_ going to be args[0].
-    char *file = argv[0];
+    struct launch launch = { .argv = args };
 
     assert(args_size <= 6);
 
+    // `spawn prog args &` starts prog as a job (see jobs.h) and carries on
+    // at once; `wait` catches up with it later.
+    int in_background = args_size > 1 && strcmp(argv[args_size-1], "&") == 0;
+    if (in_background) args_size--;
+
+    // `> file` and `2> file` redirect the program's output. They're taken
+    // out of the arguments wherever they are.
     int ix = 0;
-    for ( ; ix < args_size; ++ix) {
-        args[ix] = argv[ix];
+    for (int n = 0; n < args_size; ++n) {
+        int is_stdout = strcmp(argv[n], ">") == 0;
+        int is_stderr = strcmp(argv[n], "2>") == 0;
+        if (!is_stdout && !is_stderr) {
+            args[ix++] = argv[n];
+            continue;
+        }
+        if (n + 1 == args_size) return badcommand();
+        if (is_stdout) launch.stdout_path = argv[++n];
+        else           launch.stderr_path = argv[++n];
     }
     args[ix] = NULL;
+    if (ix == 0) return badcommand();
 
-    pid_t pid = fork();
-    if (pid == -1) {
-        perror("Fork failed");
+    if (in_background) {
+        if (job_start(&launch) < 0) printf("Failed to spawn %s\n", args[0]);
+        return 0;
+    }
+
+    // Without &, the caller waits for the program. In a script, that's
+    // a job and a wait in one: only this process blocks (see my_wait), and
+    // everything else keeps running while the program does.
+    struct PCB *pcb = running_pcb();
+    if (pcb) {
+        int id = job_start(&launch);
+        if (id > 0) pcb->waiting_for_job = id;
+        return 0;
     }
-    else if (pid > 0) {
+
+    // Typed at the prompt, there's nothing else to run anyway.
+    pid_t pid = launch_process(&launch);
+    if (pid > 0) {
         int status;
         waitpid(pid, &status, 0);
-    } else {
-        // we are the child process
-        execvp(file, args);
-        // exec never returns, so we are only here if something went wrong.
-        perror("Exec failed");
-        exit(EXIT_FAILURE);
     }
+    return 0;
+}
 
+int my_wait(char *id_arg) {
+    int id = JOB_ALL;
+    if (id_arg) {
+        // Accept `wait 2` and, like other shells, `wait %2`.
+        if (*id_arg == '%') id_arg++;
+        char *end;
+        long n = strtol(id_arg, &end, 10);
+        if (*id_arg == '\0' || *end != '\0' || n <= 0 || !job_exists(n)) {
+            printf("Bad command: no such job\n");
+            return 1;
+        }
+        id = n;
+    }
+    struct PCB *pcb = running_pcb();
+    if (pcb && job_is_running(id)) {
+        // Only this process has to wait. The scheduler takes it off the
+        // queue after this instruction, and puts it back when the job is
+        // done; everything else keeps running in the meantime.
+        pcb->waiting_for_job = id;
+        return 0;
+    }
+    // Typed at the prompt, there's nothing else to run anyway.
+    jobs_wait(id);
+    job_forget(id);
     return 0;
 }
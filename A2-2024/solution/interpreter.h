@@ -1,12 +1,30 @@
 #pragma once
-int interpreter(char *command_args[], int args_size);
+#include <stddef.h>
+#include "command.h"
+
+// The most words a command may have; exec is the only exception.
+#define MAX_ARGS_SIZE 7
+
+// symbol is the variable the command uses, if it came from a script line
+// that was resolved when its script was read, or NO_SYMBOL to look it up by name.
+int interpreter(char *command_args[], int args_size, size_t symbol);
+// The same, once the builtin named by command_args[0] has been looked up.
+int run_command(enum command cmd, char *command_args[], int args_size, size_t symbol);
+// Would run_command run the builtin, given that many words (its name
+// included), rather than reject them?
+int builtin_accepts(enum command cmd, int args_size);
 int help();
+// The builtins that compiled lines call directly (see bytecode.c).
+// Given a symbol, they don't look at the variable's name.
+int print(char *var, size_t symbol);
+int echo(char *tok, size_t symbol);
 
 // Run the given PCB to completion, then clean it up and return NULL.
-// Suitable implementation of schedule_policy::run_pcb.
-struct PCB *run_pcb_to_completion(struct PCB *pcb);
+// Used to implement schedule_policy::run_pcb.
+// If timed, every line is timed to train the cost model (see command.h).
+struct PCB *run_pcb_to_completion(struct PCB *pcb, int timed);
 // Run the given PCB for the given number of steps.
 // If it has remaining instructions, return it.
 // Otherwise, clean it up and return NULL.
-// Partial applications of n make this suitable for schedule_policy::run_pcb.
-struct PCB *run_pcb_for_n_steps(struct PCB *pcb, size_t n);
+// Used with the policy's quantum to implement schedule_policy::run_pcb.
+struct PCB *run_pcb_for_n_steps(struct PCB *pcb, size_t n, int timed);
@@ -0,0 +1,201 @@
+#define _GNU_SOURCE // pidfd_open, signalfd
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "jobs.h"
+
+struct job {
+    int id;
+    pid_t pid;
+    // The child's pidfd, in the epoll set, or -1 when using the signalfd.
+    int pidfd;
+    int running;
+    // The status from waitpid, once the job has finished.
+    int status;
+    // The command line, for the jobs builtin.
+    char *command;
+    struct job *next;
+};
+
+// The jobs, oldest first. There are only ever a handful, so a list will do.
+static struct job *job_list = NULL;
+static int next_job_id = 1;
+static int running_jobs = 0;
+
+// The epoll set, and the SIGCHLD signalfd in it if pidfds aren't supported.
+// Both are set up when the first job starts.
+static int epoll_fd = -1;
+static int sigchld_fd = -1;
+static int use_pidfds = 1;
+
+static int jobs_init(void) {
+    if (epoll_fd >= 0) return 0;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    // Find out if we can have pidfds, using our own pid.
+    int probe = syscall(SYS_pidfd_open, getpid(), 0);
+    if (probe >= 0) {
+        close(probe);
+        return 0;
+    }
+    use_pidfds = 0;
+    // SIGCHLD has to be blocked for the signalfd to get it. Children
+    // would inherit the mask, so launch_process clears it for them.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sigchld_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (sigchld_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sigchld_fd, &ev)) {
+        perror("signalfd");
+        return 1;
+    }
+    return 0;
+}
+
+static struct job *find_job(int id) {
+    for (struct job *job = job_list; job; job = job->next) {
+        if (job->id == id) return job;
+    }
+    return NULL;
+}
+
+int job_start(const struct launch *launch) {
+    if (jobs_init()) return -1;
+    pid_t pid = launch_process(launch);
+    if (pid < 0) return -1;
+    char **argv = launch->argv;
+
+    struct job *job = malloc(sizeof(struct job));
+    job->id = next_job_id++;
+    job->pid = pid;
+    job->pidfd = -1;
+    job->running = 1;
+    job->status = 0;
+    size_t length = 0;
+    for (char **arg = argv; *arg; ++arg) length += strlen(*arg) + 1;
+    job->command = calloc(length + 1, 1);
+    for (char **arg = argv; *arg; ++arg) {
+        if (arg != argv) strcat(job->command, " ");
+        strcat(job->command, *arg);
+    }
+    // Append, so the list stays in job number order.
+    job->next = NULL;
+    struct job **tail = &job_list;
+    while (*tail) tail = &(*tail)->next;
+    *tail = job;
+    running_jobs++;
+
+    if (use_pidfds) {
+        // If the child has already exited, it's a zombie until we reap it,
+        // so the pidfd still refers to it and is readable at once.
+        job->pidfd = syscall(SYS_pidfd_open, pid, 0);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = job };
+        if (job->pidfd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, job->pidfd, &ev)) {
+            // Nothing would ever tell us that the child exited, and a wait
+            // for it would never end. So wait for it now, like a spawn
+            // without & does, and it's finished before anyone can ask.
+            perror("pidfd_open");
+            if (job->pidfd >= 0) close(job->pidfd);
+            job->pidfd = -1;
+            waitpid(pid, &job->status, 0);
+            job->running = 0;
+            running_jobs--;
+        }
+    }
+    return job->id;
+}
+
+// Reap the job if it has exited. Returns 1 if it had.
+static int reap(struct job *job) {
+    if (!job->running || waitpid(job->pid, &job->status, WNOHANG) <= 0) {
+        return 0;
+    }
+    job->running = 0;
+    running_jobs--;
+    if (job->pidfd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, job->pidfd, NULL);
+        close(job->pidfd);
+        job->pidfd = -1;
+    }
+    return 1;
+}
+
+void jobs_poll(int timeout_ms) {
+    if (!running_jobs) return;
+    struct epoll_event events[16];
+    int count;
+    do {
+        count = epoll_wait(epoll_fd, events, 16, timeout_ms);
+    } while (count < 0 && errno == EINTR);
+
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.ptr) {
+            reap(events[i].data.ptr);
+        } else {
+            // SIGCHLDs merge, so one might stand for several exits.
+            struct signalfd_siginfo info;
+            while (read(sigchld_fd, &info, sizeof(info)) == sizeof(info)) {}
+            for (struct job *job = job_list; job; job = job->next) reap(job);
+        }
+    }
+}
+
+int job_is_running(int id) {
+    if (id == JOB_ALL) return running_jobs > 0;
+    struct job *job = find_job(id);
+    return job && job->running;
+}
+
+int job_exists(int id) {
+    return find_job(id) != NULL;
+}
+
+void job_forget(int id) {
+    struct job **link = &job_list;
+    while (*link) {
+        struct job *job = *link;
+        if (!job->running && (id == JOB_ALL || job->id == id)) {
+            *link = job->next;
+            free(job->command);
+            free(job);
+        } else {
+            link = &job->next;
+        }
+    }
+}
+
+void jobs_wait(int id) {
+    while (job_is_running(id)) jobs_poll(-1);
+}
+
+int jobs(void) {
+    jobs_poll(0);
+    for (struct job *job = job_list; job; job = job->next) {
+        char state[32];
+        if (job->running) {
+            snprintf(state, sizeof(state), "Running");
+        } else if (WIFSIGNALED(job->status)) {
+            snprintf(state, sizeof(state), "Signal %d", WTERMSIG(job->status));
+        } else if (WEXITSTATUS(job->status)) {
+            snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(job->status));
+        } else {
+            snprintf(state, sizeof(state), "Done");
+        }
+        printf("[%d] %-10s %s\n", job->id, state, job->command);
+    }
+    job_forget(JOB_ALL);
+    return 0;
+}
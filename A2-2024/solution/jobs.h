@@ -0,0 +1,44 @@
+#pragma once
+#include "launch.h"
+
+// Jobs: external programs started by `spawn ... &`, which run alongside the
+// shell and its scripts instead of stopping everything until they exit.
+// A plain `spawn` in a script is a job too, which only its process waits on.
+// Each gets a small job number, counting up from 1, for `wait` and `jobs`.
+//
+// Children are watched through an epoll set. Each child has a pidfd in the
+// set, which becomes readable when the child exits. On kernels without
+// pidfd_open, the set holds a signalfd for SIGCHLD instead, and every
+// running job is checked with waitpid when it fires. Either way, nothing is
+// polled unless some job is running, and the scheduler can sleep in
+// jobs_poll when every process is blocked waiting on a job.
+
+// Waiting for this job number means waiting for every job.
+#define JOB_ALL (-1)
+
+// Start the program (see launch.h) in the background.
+// Returns the job number, or -1 if it couldn't be started.
+int job_start(const struct launch *launch);
+
+// Collect the exit of any job that has finished. Waits up to timeout_ms
+// for one to finish first; -1 waits for as long as it takes, 0 not at all.
+void jobs_poll(int timeout_ms);
+
+// Is the job still running? JOB_ALL asks if any job is.
+// Finished and unknown jobs are not running.
+int job_is_running(int id);
+
+// Is there a job with this number, running or finished but not forgotten?
+int job_exists(int id);
+
+// Drop a finished job from the table; JOB_ALL drops every finished job.
+// Running jobs are left alone.
+void job_forget(int id);
+
+// Wait, blocking the whole shell, until the job has finished.
+// JOB_ALL waits for every job.
+void jobs_wait(int id);
+
+// The jobs builtin: print every job and its state, then forget the
+// finished ones, since they've now been reported.
+int jobs(void);
@@ -0,0 +1,85 @@
+#define _GNU_SOURCE // execvpe
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "launch.h"
+
+extern char **environ;
+
+#define REDIRECT_FLAGS (O_WRONLY | O_CREAT | O_TRUNC)
+#define REDIRECT_MODE 0644
+
+pid_t launch_process(const struct launch *launch) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    // The redirections are done in the child, between the clone and the
+    // exec, so the shell's own stdout is never touched.
+    if (launch->stdout_path) {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
+                launch->stdout_path, REDIRECT_FLAGS, REDIRECT_MODE);
+    }
+    if (launch->stderr_path) {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO,
+                launch->stderr_path, REDIRECT_FLAGS, REDIRECT_MODE);
+    }
+    // The shell may block SIGCHLD to watch its jobs (see jobs.c); the
+    // program shouldn't inherit that.
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    // Anything we've printed has to come out before the child's output.
+    fflush(stdout);
+    pid_t pid;
+    int error = posix_spawnp(&pid, launch->argv[0], &actions, &attr,
+                             launch->argv, launch->envp ? launch->envp : environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error) {
+        fprintf(stderr, "Exec failed: %s\n", strerror(error));
+        return -1;
+    }
+    return pid;
+}
+
+// Open path over fd, in a forked child. Exits the child if it can't.
+static void redirect(int fd, const char *path) {
+    int file = open(path, REDIRECT_FLAGS, REDIRECT_MODE);
+    if (file < 0 || dup2(file, fd) < 0) {
+        perror("Redirect failed");
+        exit(EXIT_FAILURE);
+    }
+    close(file);
+}
+
+pid_t launch_process_fork(const struct launch *launch) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Fork failed");
+        return -1;
+    }
+    if (pid == 0) {
+        // we are the child process
+        if (launch->stdout_path) redirect(STDOUT_FILENO, launch->stdout_path);
+        if (launch->stderr_path) redirect(STDERR_FILENO, launch->stderr_path);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        execvpe(launch->argv[0], launch->argv,
+                launch->envp ? launch->envp : environ);
+        // exec never returns, so we are only here if something went wrong.
+        perror("Exec failed");
+        exit(EXIT_FAILURE);
+    }
+    return pid;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <sys/types.h> // pid_t
+
+// Starting external programs, for spawn.
+//
+// fork() copies the shell's page tables, so it gets slower as the shell
+// grows: line memory, variables, cached scripts all add to the bill, only
+// for the child to throw the copy away at execvp. launch_process uses
+// posix_spawnp instead, which glibc implements with a vfork-style clone
+// that shares the shell's memory until the exec, so it costs the same
+// however big the shell is. bench/bench_spawn measures the difference.
+
+struct launch {
+    // The program and its arguments, NULL-terminated. argv[0] is looked up
+    // on the PATH.
+    char **argv;
+    // The environment, NULL-terminated, or NULL for the shell's own.
+    char **envp;
+    // If not NULL, the child's stdout/stderr go to these files, which are
+    // created or truncated, instead of the shell's.
+    const char *stdout_path;
+    const char *stderr_path;
+};
+
+// Start the program. Returns its pid, or -1 (with a message on stderr)
+// if it couldn't be started, e.g. because there's no such program.
+// The child starts with no signals blocked, whatever the shell blocks.
+pid_t launch_process(const struct launch *launch);
+
+// The same, with fork() and execvp(), as spawn used to. Only the
+// benchmark uses this now.
+pid_t launch_process_fork(const struct launch *launch);
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> // memset
-#include "shell.h" // MAX_USER_INPUT
 #include "shellmemory.h"
 #include "pcb.h"
+#include "timing.h"
+
+int pcb_is_shell_input(struct PCB *pcb) {
+    return pcb->name[0] == '\0';
+}
 
 int pcb_has_next_instruction(struct PCB *pcb) {
     // have next if pc < line_count.
@@ -14,34 +18,111 @@ int pcb_has_next_instruction(struct PCB *pcb) {
 size_t pcb_next_instruction(struct PCB *pcb) {
     size_t i = pcb->line_base + pcb->pc;
     pcb->pc++;
+    pcb->remaining_by_command[get_line_command(i)]--;
     return i;
 }
 
-struct PCB *create_process(const char *filename) {
-    // We have 2 main tasks:
-    // load all the code in the script file into shellmemory, and
-    // allocate+fill a PCB.
+double pcb_predicted_cost(struct PCB *pcb) {
+    double cost = 0;
+    for (int cmd = 0; cmd < CMD_COUNT; ++cmd) {
+        cost += pcb->remaining_by_command[cmd] * command_cost(cmd);
+    }
+    return cost;
+}
 
-    // We don't want to allocate a PCB until we know we actually need one,
-    // so let's first make sure we can open the file.
-    FILE *script = fopen(filename, "rt");
-    if (!script) {
-        perror("failed to open file for create_process");
-        return NULL;
+// ---------------------
+// The process table. pids are handed out in increasing order, so a lower pid
+// still means "exec'd first" (CFS and EDF break ties that way), and the PCB
+// with pid p lives in slot p % capacity. The capacity is a power of two and
+// at least twice the number of live processes, so a free slot turns up
+// after skipping a pid or two, and the table doubles when it gets half full.
+// A stale pid finds either an empty slot or a PCB with a different pid.
+// Allocating, freeing and looking up are all O(1) (amortized, when growing),
+// and there's no limit on the number of processes.
+// ---------------------
+
+static struct PCB **process_table = NULL;
+static size_t table_capacity = 0, live_processes = 0;
+static pid fresh_pid = 1;
+
+static void grow_process_table(void) {
+    size_t old_capacity = table_capacity;
+    struct PCB **old_table = process_table;
+    table_capacity = old_capacity ? 2 * old_capacity : 16;
+    process_table = calloc(table_capacity, sizeof(struct PCB *));
+    // Two live pids that didn't collide before can't collide now, since
+    // the new slot is just one more bit of the pid.
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old_table[i]) {
+            process_table[old_table[i]->pid & (table_capacity - 1)] = old_table[i];
+        }
     }
-    struct PCB *pcb = create_process_from_FILE(script);
-    // Update the pcb name according to the filename we received.
-    pcb->name = strdup(filename);
+    free(old_table);
 }
 
-struct PCB *create_process_from_FILE(FILE *script) {
-    // We can open the file, so we'll be making a process.
+// Give pcb a pid, and its slot in the table.
+static void allocate_pid(struct PCB *pcb) {
+    if (2 * (live_processes + 1) > table_capacity) grow_process_table();
+    // Skip pids whose slot is taken by a process that's still around.
+    while (process_table[fresh_pid & (table_capacity - 1)]) fresh_pid++;
+    pcb->pid = fresh_pid++;
+    process_table[pcb->pid & (table_capacity - 1)] = pcb;
+    live_processes++;
+}
+
+static void release_pid(pid id) {
+    process_table[id & (table_capacity - 1)] = NULL;
+    live_processes--;
+}
+
+struct PCB *pcb_lookup(pid id) {
+    if (!table_capacity) return NULL;
+    struct PCB *pcb = process_table[id & (table_capacity - 1)];
+    return pcb && pcb->pid == id ? pcb : NULL;
+}
+
+static int pid_compare(const void *a, const void *b) {
+    pid x = (*(struct PCB *const *)a)->pid, y = (*(struct PCB *const *)b)->pid;
+    return x < y ? -1 : x > y;
+}
+
+// A ring of copies of the last PCB_EXIT_HISTORY PCBs to be freed, so that
+// ps can still show the turnaround of processes that have finished.
+// The copies own their names.
+static struct PCB recently_exited[PCB_EXIT_HISTORY];
+static size_t exits_seen = 0;
+
+// Take a copy of pcb for the history. Takes ownership of the name, too.
+static void remember_exit(struct PCB *pcb) {
+    struct PCB *slot = &recently_exited[exits_seen++ % PCB_EXIT_HISTORY];
+    // Free the name of the copy we're replacing, but only if it's not the
+    // empty string. The empty name (for the shell input process) was not
+    // malloc'd.
+    if (slot->name && strcmp("", slot->name)) {
+        free(slot->name);
+    }
+    *slot = *pcb;
+    slot->script = NULL;
+    slot->next = NULL;
+}
+
+// Make a process to run script, taking the reference to it.
+static struct PCB *create_process_from_script(struct script *script) {
+    // A script bigger than the whole line memory would wait for admission
+    // forever, so give up on it now, before it's a process: it never ran,
+    // so it has no business in the exit history.
+    if (script->line_count > MEM_SIZE) {
+        script_release(script);
+        return NULL;
+    }
+
+    // We have the code, so we'll be making a process.
     struct PCB *pcb = malloc(sizeof(struct PCB));
 
-    // The PID is the only weird part. They need to be distinct,
-    // so let's use a static counter.
-    static pid fresh_pid = 1;
-    pcb->pid = fresh_pid++;
+    // The PID is the only weird part. They need to be distinct, and we
+    // want to find the PCB again from its pid, so the process table
+    // hands them out.
+    allocate_pid(pcb);
 
     // name should be the empty string, according to doc comment.
     pcb->name = "";
@@ -50,59 +131,107 @@ struct PCB *create_process_from_FILE(FILE *script) {
 
     // pc is always initially 0.
     pcb->pc = 0;
-
-    // create initial values for base and count, in case we fail to read
-    // any lines from the file. That way we'll end up with an empty process
-    // that terminates as soon as it is scheduled -- reasonable behavior for
-    // an empty script.
-    // If we don't do this, and the loop below never runs, base would be
-    // unitialized, which would be catastrophic.
-    pcb->line_count = 0;
+    // Every process enters MLFQ at the top level.
+    pcb->level = 0;
+    // Everyone gets an equal share unless exec says otherwise.
+    pcb->weight = 1;
+    pcb->vruntime = 0;
+    pcb->deadline = PCB_NO_DEADLINE;
+    pcb->waiting_for_job = 0;
+    memset(&pcb->stats, 0, sizeof(pcb->stats));
+    pcb->stats.created = pcb->stats.ready_since = monotonic_ns();
+
+    // The script is read (or found) already, so its lines are counted and
+    // classified; the PCB only needs its own copy of the counts, which it
+    // uses up as it runs. An empty script ends up as an empty process that
+    // terminates as soon as it is scheduled -- reasonable behavior.
+    pcb->script = script;
+    pcb->loaded = 0;
+    pcb->line_count = script->line_count;
     pcb->line_base = 0;
+    memcpy(pcb->remaining_by_command, script->count_by_command,
+           sizeof(pcb->remaining_by_command));
 
-    // We're told to assume lines of files are limited to 100 characters.
-    // That's all well and good, but for implementing # we need to read
-    // actual user input, and _that_ is limited to 1000 characters.
-    // It's unclear if we should assume it's also limited to 100 for this
-    // purpose. If you did assume that, that's OK! We didn't.
-    char linebuf[MAX_USER_INPUT];
-    while (!feof(script)) {
-        memset(linebuf, 0, sizeof(linebuf));
-        fgets(linebuf, MAX_USER_INPUT, script);
-
-        size_t index = allocate_line(linebuf);
-        // If we've run out of memory, clean up the partially-allocated
-        // pcb and return NULL.
-        if (index == (size_t)(-1)) {
-            free_pcb(pcb);
-            fclose(script);
-            return NULL;
-        }
+    // duration should initially match line_count.
+    pcb->duration = pcb->line_count;
 
-        if (pcb->line_count == 0) {
-            // do this on the first iteration only.
-            pcb->line_base = index;
-        }
-        pcb->line_count++;
+    return pcb;
+}
+
+struct PCB *create_process(const char *filename) {
+    // We have 2 main tasks:
+    // get the code in the script file, and
+    // allocate+fill a PCB.
+
+    // We don't want to allocate a PCB until we know we actually need one,
+    // so let's first make sure we can get the code. If the script was run
+    // recently, and hasn't changed since, the cache has it already.
+    struct script *script = script_open(filename);
+    if (!script) {
+        perror("failed to open file for create_process");
+        return NULL;
     }
+    struct PCB *pcb = create_process_from_script(script);
+    if (!pcb) return NULL;
+    // Update the pcb name according to the filename we received.
+    pcb->name = strdup(filename);
+    return pcb;
+}
 
-    // We're done with the file, don't forget to close it!
-    fclose(script);
+struct PCB *create_process_from_FILE(FILE *script) {
+    return create_process_from_script(script_read(script));
+}
 
-    // duration should initially match line_count.
-    pcb->duration = pcb->line_count;
+int pcb_is_loaded(struct PCB *pcb) {
+    return pcb->loaded;
+}
 
-    return pcb;
+int pcb_load(struct PCB *pcb) {
+    if (pcb_is_loaded(pcb)) return 0;
+    size_t base = allocate_lines(pcb->line_count);
+    if (base == (size_t)(-1)) return 1;
+
+    pcb->line_base = base;
+    struct script *script = pcb->script;
+    for (size_t i = 0; i < pcb->line_count; ++i) {
+        store_line(base + i, script->lines[i], script->commands[i],
+                   script->code[i]);
+    }
+    pcb->loaded = 1;
+    return 0;
 }
 
 void free_pcb(struct PCB *pcb) {
-    for (size_t ix = pcb->line_base; ix < pcb->line_base + pcb->line_count; ++ix) {
-        free_line(ix);
-    }
-    // Free the process name, but only if it's not the empty string.
-    // The empty name (for the shell input process) was not malloc'd.
-    if (strcmp("", pcb->name)) {
-        free(pcb->name);
+    if (pcb_is_loaded(pcb)) {
+        for (size_t ix = pcb->line_base; ix < pcb->line_base + pcb->line_count; ++ix) {
+            free_line(ix);
+        }
     }
+    script_release(pcb->script);
+    pcb->stats.exited = monotonic_ns();
+    remember_exit(pcb);
+    release_pid(pcb->pid);
     free(pcb);
 }
+
+void pcb_for_each(void (*fn)(struct PCB*, void*), void *arg) {
+    // Slots aren't in pid order once pids wrap around the table, so sort
+    // them. The table can hold any number of processes, but only ps and
+    // top (see ps.c) come here, and the O(n log n) is nothing next to
+    // printing a line for each one.
+    struct PCB **live = malloc((live_processes + 1) * sizeof(struct PCB *));
+    size_t count = 0;
+    for (size_t i = 0; i < table_capacity; ++i) {
+        if (process_table[i]) live[count++] = process_table[i];
+    }
+    qsort(live, count, sizeof(struct PCB *), pid_compare);
+    for (size_t i = 0; i < count; ++i) fn(live[i], arg);
+    free(live);
+}
+
+void pcb_for_each_exited(void (*fn)(struct PCB*, void*), void *arg) {
+    size_t count = exits_seen < PCB_EXIT_HISTORY ? exits_seen : PCB_EXIT_HISTORY;
+    for (size_t i = exits_seen - count; i < exits_seen; ++i) {
+        fn(&recently_exited[i % PCB_EXIT_HISTORY], arg);
+    }
+}
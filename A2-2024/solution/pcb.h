@@ -1,9 +1,20 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h> // FILE
+#include "command.h"
+#include "script.h"
 
 typedef size_t pid;
 
+// vruntime is kept in units of 1/VRUNTIME_SCALE instructions so that the
+// division by weight doesn't throw away all of the precision. This is the
+// STRIDE1 constant of stride scheduling.
+#define VRUNTIME_SCALE (1 << 20)
+
+// A deadline later than any real one, so EDF runs these processes last.
+#define PCB_NO_DEADLINE UINT64_MAX
+
 // A process info struct.
 struct PCB {
     pid pid;
@@ -25,11 +36,59 @@ struct PCB {
     // it with pseudo-paging later. Spoilers!
     size_t line_base;
     size_t line_count;
+    // The process's code, which it shares with any other process running
+    // the same script, and with the script cache (see script.h).
+    // Until the process is admitted, there may not be room for it in the
+    // line memory, so line_base means nothing until pcb_load puts the
+    // lines there and sets loaded.
+    struct script *script;
+    int loaded;
 
     // This field is used for SJF and aging, and should initially have
     // the same value as line_count.
     size_t duration;
 
+    // This field is used for MLFQ, and holds the index of the level this PCB
+    // is queued at. 0 is the highest priority; it is initially 0.
+    size_t level;
+
+    // These fields are used for CFS, STRIDE and LOTTERY. weight is the
+    // process's relative share of the interpreter (its ticket count, for the
+    // latter two), given as `exec prog:weight ...` and 1 otherwise.
+    // vruntime is the number of instructions executed, scaled by
+    // VRUNTIME_SCALE / weight, so heavier processes age more slowly.
+    // For STRIDE, this is exactly the "pass" value.
+    size_t weight;
+    size_t vruntime;
+
+    // This field is used for SJFP. It counts the lines from pc onward that
+    // start with each command, so the remaining work can be predicted from
+    // the per-command cost model.
+    size_t remaining_by_command[CMD_COUNT];
+
+    // This field is used for EDF. It is the CLOCK_MONOTONIC time, in
+    // nanoseconds, by which the process should finish: `exec prog@ms ...`
+    // sets it ms milliseconds after the exec. Otherwise it is PCB_NO_DEADLINE.
+    uint64_t deadline;
+
+    // The job (see jobs.h) the process is blocked on, after a `wait`, or 0
+    // if it isn't blocked. JOB_ALL means it's waiting for every job. The
+    // scheduler keeps blocked processes off the queues until the wait is
+    // over.
+    int waiting_for_job;
+
+    // Accounting, for ps and top. The number of instructions executed is
+    // just pc. The times are monotonic_ns() (see timing.h) and are only read
+    // at slice boundaries, so keeping them costs next to nothing.
+    struct pcb_stats {
+        size_t quanta;            // times the process has been dispatched
+        size_t context_switches;  // ...when something else had run last
+        uint64_t created;         // when exec made the process
+        uint64_t ready_since;     // when it last went back on a queue
+        uint64_t ready_ns;        // total time spent waiting to run
+        uint64_t exited;          // when it finished; 0 while it's alive
+    } stats;
+
     // pc is the number of the instruction next to execute.
     // For example, it is initially 0, **regardless** of the value of
     // line_base. (Think of it as the "virtual address" of the next insn.)
@@ -46,21 +105,45 @@ struct PCB {
     struct PCB *next;
 };
 
+// The live process with the given pid, or NULL if there isn't one.
+// This is O(1). pids are never reused, so a pid stays dead once its
+// process is freed, even though its slot in the process table is reused.
+struct PCB *pcb_lookup(pid id);
+// Returns non-zero iff this is the 'shell input' process (see PCB::name).
+int pcb_is_shell_input(struct PCB *pcb);
 // Returns non-zero iff there are more instructions to execute.
 int pcb_has_next_instruction(struct PCB *pcb);
 // Get the shellmemory index of the next instruction, and increment pc.
 size_t pcb_next_instruction(struct PCB *pcb);
+// The predicted time to run the rest of this process, in nanoseconds,
+// according to the per-command cost model (see command.h).
+double pcb_predicted_cost(struct PCB *pcb);
 // Create a new process from the given filename:
-//   1. Allocates a new PCB
-//   2. Loads the code from the script file into shellmemory
+//   1. Allocates a new PCB, and a pid for it in the process table
+//   2. Reads and compiles the code from the script file, or finds it in the
+//      script cache, but does NOT load it into shellmemory yet; see pcb_load
 //   3. Does NOT enqueue the PCB to any scheduling queue (next is NULL)
+// Returns NULL if the file can't be read, or could never fit in shellmemory.
 struct PCB *create_process(const char *filename);
-// Like create_process, but takes a FILE* directly.
+// Like create_process, but takes a FILE* directly, which isn't cached.
 // Ownership of the FILE* is taken and it will be closed.
 struct PCB *create_process_from_FILE(FILE *f);
+// Returns non-zero iff the process's code is in shellmemory, so it can run.
+int pcb_is_loaded(struct PCB *pcb);
+// Load the process's code into shellmemory, if it isn't already.
+// Returns 0 on success, or non-zero if there isn't room for it right now.
+int pcb_load(struct PCB *pcb);
 // Cleanup a process:
 //   1. Free all shellmemory used by the process code
-//   2. Free the PCB
+//   2. Free the PCB, and its pid
+//   3. Remember its name and stats among the recently exited processes
 void free_pcb(struct PCB *pcb);
 
+// Call fn on every live process, in pid order.
+void pcb_for_each(void (*fn)(struct PCB*, void*), void *arg);
+// Call fn on the last PCB_EXIT_HISTORY processes to exit, oldest first.
+// Only the pid, name, pc, line_count and stats of these are meaningful.
+void pcb_for_each_exited(void (*fn)(struct PCB*, void*), void *arg);
+#define PCB_EXIT_HISTORY 8
+
 
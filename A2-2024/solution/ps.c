@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <unistd.h> // isatty
+#include "pcb.h"
+#include "ps.h"
+#include "scheduler.h"
+#include "timing.h"
+
+#define NS_PER_MS 1000000
+
+static void print_process(struct PCB *pcb, void *arg) {
+    uint64_t now = *(uint64_t *)arg;
+    char state;
+    if (pcb->stats.exited)              state = 'X';
+    else if (pcb == running_pcb())      state = 'R';
+    else if (pcb->waiting_for_job)      state = 'B';
+    else if (!pcb_is_loaded(pcb))       state = 'W';
+    else                                state = 'Q';
+
+    // The running process is partway through a slice, which hasn't been
+    // added to anything yet, so there's nothing extra to account for.
+    uint64_t ready = pcb->stats.ready_ns;
+    // Blocked time isn't ready time; ready_since is reset on waking up.
+    if (state == 'Q' || state == 'W') ready += now - pcb->stats.ready_since;
+    uint64_t end = pcb->stats.exited ? pcb->stats.exited : now;
+
+    printf("%5zu %c  %-16s %6zu %6zu %5zu %9llu %9llu %5zu\n",
+           pcb->pid, state, pcb_is_shell_input(pcb) ? "(shell)" : pcb->name,
+           pcb->pc, pcb->stats.quanta, pcb->stats.context_switches,
+           (unsigned long long)(ready / NS_PER_MS),
+           (unsigned long long)((end - pcb->stats.created) / NS_PER_MS),
+           pcb->stats.exited || !pcb_is_loaded(pcb) ? 0 : pcb->line_count);
+}
+
+int ps(void) {
+    uint64_t now = monotonic_ns();
+    printf("  PID ST NAME              INSNS QUANTA   CSW  READY_MS   TURN_MS LINES\n");
+    pcb_for_each(print_process, &now);
+    pcb_for_each_exited(print_process, &now);
+    return 0;
+}
+
+static int top_enabled = 0;
+static uint64_t top_last_shown;
+
+static void top_show(void) {
+    // Clearing the screen is what makes it look like it refreshes in place;
+    // in a log it would just be noise.
+    if (isatty(STDOUT_FILENO)) printf("\033[H\033[2J");
+    ps();
+    fflush(stdout);
+    top_last_shown = monotonic_ns();
+}
+
+int top(void) {
+    top_enabled = 1;
+    top_show();
+    return 0;
+}
+
+void top_refresh(void) {
+    if (!top_enabled) return;
+    if (monotonic_ns() - top_last_shown < (uint64_t)TOP_REFRESH_MS * NS_PER_MS) {
+        return;
+    }
+    top_show();
+}
+
+void top_stop(void) {
+    top_enabled = 0;
+}
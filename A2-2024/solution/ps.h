@@ -0,0 +1,30 @@
+#pragma once
+
+// The ps and top builtins, which show the accounting kept in each PCB
+// (see PCB::stats).
+
+// Print a line for every live process, then for the recently exited ones.
+// Columns:
+//   PID, ST     R running, Q queued, W waiting for admission,
+//               B blocked in wait, X exited
+//   NAME        the script, or (shell) for the rest of a # batch
+//   INSNS       instructions executed so far
+//   QUANTA      times dispatched; CSW, how many of those were switches
+//   READY_MS    time spent waiting to run
+//   TURN_MS     time since exec, or from exec to exit once it has exited
+//   LINES       lines of shellmemory held; A2 has no paging, so this is
+//               what stands in for resident frames
+int ps(void);
+
+// Show ps, and keep showing it every TOP_REFRESH_MS until the schedule
+// finishes. The screen is cleared between refreshes if stdout is a terminal.
+int top(void);
+#ifndef TOP_REFRESH_MS
+#define TOP_REFRESH_MS 1000
+#endif
+
+// Called by the scheduler at slice boundaries; shows ps again if top is on
+// and it's been long enough. Cheap when top is off.
+void top_refresh(void);
+// Called by the scheduler when the schedule finishes; turns top off.
+void top_stop(void);
@@ -1,17 +1,45 @@
 #include <assert.h>
-#include <stdlib.h>
+#include <stdint.h>
+#include <stdlib.h> // rand_r
 #include <string.h>
 #include "pcb.h"
 #include "queue.h"
 
 struct queue {
     struct PCB *head;
+    // The last PCB on head, or NULL if head is empty. Round robin puts a
+    // PCB back at the tail after every slice, and there can be hundreds of
+    // them, so finding the tail mustn't mean walking the list.
+    struct PCB *tail;
 
-    // Why no tail? Simply put; there's only ever 4 items in our queue.
-    // Dereferencing 4 pointers is not so slow.
-    // On the other hand, properly implementing the bookkeeping for a tail
-    // pointer is headache-inducing!
-    //struct PCB *tail;
+    // MLFQ doesn't use head for its levels, only for PCBs that are enqueued
+    // ignoring priority. Each level is a list just like head.
+    struct PCB *levels[MLFQ_MAX_LEVELS];
+
+    // CFS can have hundreds of runnable PCBs and picks the smallest vruntime
+    // on every slice, so it keeps them in a binary min-heap instead of a
+    // list. The heap array grows as needed.
+    struct PCB **heap;
+    size_t heap_size;
+    size_t heap_capacity;
+    // The largest vruntime that has been dequeued so far. New PCBs are
+    // placed here rather than at 0, so that a late `exec` from the
+    // background doesn't get to monopolize the interpreter while it
+    // catches up.
+    size_t min_vruntime;
+
+    // LOTTERY reuses the heap array, but not the heap order: it treats the
+    // array as a complete binary tree and ticket_sums[i] is the total weight
+    // of the subtree rooted at heap[i]. That lets it draw a ticket and find
+    // the winner in O(log n).
+    size_t *ticket_sums;
+    // State for rand_r. Fixed at allocation so that runs are repeatable.
+    unsigned lottery_seed;
+
+    // How many PCBs are on the queue, counting every list and the heap.
+    // The scheduler asks on every slice (see queue_size), so it's kept up
+    // to date by each enqueue and dequeue rather than counted.
+    size_t size;
 
     // pthread_mutex_t lock;
 };
@@ -21,35 +49,153 @@ struct queue {
 
 struct queue *alloc_queue() {
     struct queue *q = malloc(sizeof(struct queue));
-    q->head = NULL;
+    q->head = q->tail = NULL;
+    for (size_t i = 0; i < MLFQ_MAX_LEVELS; ++i) {
+        q->levels[i] = NULL;
+    }
+    q->heap = NULL;
+    q->heap_size = 0;
+    q->heap_capacity = 0;
+    q->min_vruntime = 0;
+    q->ticket_sums = NULL;
+    q->lottery_seed = LOTTERY_SEED;
+    q->size = 0;
     return q;
 }
 
+// Every list a PCB could be queued on. Index 0 is head, then the MLFQ levels.
+// Functions that have to look at everything on the queue should loop over
+// these rather than just following head.
+#define QUEUE_LIST_COUNT (1 + MLFQ_MAX_LEVELS)
+
+static struct PCB **queue_list(struct queue *q, size_t i) {
+    return i == 0 ? &q->head : &q->levels[i - 1];
+}
+
 void free_queue(struct queue *q) {
     // Free all PCBs in the queue as well!
     // This might be relevant if we discover an error
     // while creating the schedule, e.g. can't open a file or
     // two scripts have the same name.
-    struct PCB *p = q->head;
-    while (p) {
-        struct PCB *next = p->next;
-        free_pcb(p);
-        p = next;
+    for (size_t i = 0; i < QUEUE_LIST_COUNT; ++i) {
+        struct PCB *p = *queue_list(q, i);
+        while (p) {
+            struct PCB *next = p->next;
+            free_pcb(p);
+            p = next;
+        }
+    }
+    for (size_t i = 0; i < q->heap_size; ++i) {
+        free_pcb(q->heap[i]);
     }
+    free(q->heap);
+    free(q->ticket_sums);
     free(q);
 }
 
 int program_already_scheduled(struct queue *q, char *name) {
-    struct PCB *p = q->head;
-    while (p) {
-        if (strcmp(p->name, name) == 0) return 1;
-        p = p->next;
+    for (size_t i = 0; i < QUEUE_LIST_COUNT; ++i) {
+        struct PCB *p = *queue_list(q, i);
+        while (p) {
+            if (strcmp(p->name, name) == 0) return 1;
+            p = p->next;
+        }
+    }
+    for (size_t i = 0; i < q->heap_size; ++i) {
+        if (strcmp(q->heap[i]->name, name) == 0) return 1;
     }
     return 0;
 }
 
+void queue_for_each(struct queue *q, void (*fn)(struct PCB *, void *), void *arg) {
+    for (size_t i = 0; i < QUEUE_LIST_COUNT; ++i) {
+        for (struct PCB *p = *queue_list(q, i); p; p = p->next) {
+            fn(p, arg);
+        }
+    }
+    for (size_t i = 0; i < q->heap_size; ++i) {
+        fn(q->heap[i], arg);
+    }
+}
+
+size_t queue_size(struct queue *q) {
+    return q->size;
+}
+
+// ---------------------
+// Binary min-heap of PCBs, ordered by a comparison function.
+// ---------------------
+// The comparison is passed to each operation rather than stored, like the
+// rest of this file leaves policy decisions to the caller. A given queue must
+// of course always be used with the same comparison.
+
+typedef int (*pcb_less_fn)(const struct PCB *a, const struct PCB *b);
+
+static void heap_swap(struct queue *q, size_t i, size_t j) {
+    struct PCB *tmp = q->heap[i];
+    q->heap[i] = q->heap[j];
+    q->heap[j] = tmp;
+}
+
+static void heap_reserve_one(struct queue *q) {
+    if (q->heap_size == q->heap_capacity) {
+        q->heap_capacity = q->heap_capacity ? 2 * q->heap_capacity : 8;
+        q->heap = realloc(q->heap, q->heap_capacity * sizeof(struct PCB *));
+    }
+}
+
+static void heap_push(struct queue *q, struct PCB *pcb, pcb_less_fn less) {
+    heap_reserve_one(q);
+    // Sift up from the new leaf.
+    size_t i = q->heap_size++;
+    q->heap[i] = pcb;
+    q->size++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!less(q->heap[i], q->heap[parent])) break;
+        heap_swap(q, i, parent);
+        i = parent;
+    }
+}
+
+static struct PCB *heap_pop(struct queue *q, pcb_less_fn less) {
+    if (q->heap_size == 0) {
+        return NULL;
+    }
+    struct PCB *top = q->heap[0];
+    // Move the last leaf to the root and sift it down.
+    q->size--;
+    q->heap[0] = q->heap[--q->heap_size];
+    size_t i = 0;
+    while (1) {
+        size_t l = 2 * i + 1, r = l + 1, min = i;
+        if (l < q->heap_size && less(q->heap[l], q->heap[min])) min = l;
+        if (r < q->heap_size && less(q->heap[r], q->heap[min])) min = r;
+        if (min == i) break;
+        heap_swap(q, i, min);
+        i = min;
+    }
+    return top;
+}
+
+// Ties go to the lower pid, which is the one that was exec'd first.
+static int cfs_less(const struct PCB *a, const struct PCB *b) {
+    if (a->vruntime != b->vruntime) return a->vruntime < b->vruntime;
+    return a->pid < b->pid;
+}
+
+// Append pcb to the tail of the list starting at *list.
+static void append_to_list(struct PCB **list, struct PCB *pcb) {
+    while (*list) {
+        list = &(*list)->next;
+    }
+    *list = pcb;
+}
+
 
 void enqueue_ignoring_priority(struct queue *q, struct PCB *pcb) {
+    q->size++;
+    if (!q->head) q->tail = pcb;
     pcb->next = q->head;
     q->head = pcb;
 }
@@ -57,30 +203,84 @@ void enqueue_ignoring_priority(struct queue *q, struct PCB *pcb) {
 void enqueue_fcfs(struct queue *q, struct PCB *pcb) {
     // sanity check: some dequeue operation didn't do its job if this isn't NULL.
     assert(pcb->next == NULL);
-    struct PCB *p = q->head;
+    q->size++;
 
-    if (!p) {
-        q->head = pcb;
+    if (!q->head) {
+        q->head = q->tail = pcb;
         return;
     }
+    q->tail->next = pcb;
+    q->tail = pcb;
+}
 
-    // otherwise p is a real PCB.
-    // Until it's the tail, step down the list.
-    while (p->next) {
-        p = p->next;
+void enqueue_mlfq(struct queue *q, struct PCB *pcb) {
+    assert(pcb->next == NULL);
+    assert(pcb->level < MLFQ_MAX_LEVELS);
+    q->size++;
+    append_to_list(&q->levels[pcb->level], pcb);
+}
+
+void enqueue_cfs(struct queue *q, struct PCB *pcb) {
+    assert(pcb->next == NULL);
+    // Same trick as enqueue_aging: a PCB that hasn't run yet is being
+    // scheduled for the first time.
+    if (pcb->pc == 0 && pcb->vruntime < q->min_vruntime) {
+        pcb->vruntime = q->min_vruntime;
     }
+    heap_push(q, pcb, cfs_less);
+}
 
-    // Now p is the current tail of the queue. Append pcb.
-    p->next = pcb;
+// Ties go to the lower pid, like CFS.
+static int edf_less(const struct PCB *a, const struct PCB *b) {
+    if (a->deadline != b->deadline) return a->deadline < b->deadline;
+    return a->pid < b->pid;
+}
+
+void enqueue_edf(struct queue *q, struct PCB *pcb) {
+    assert(pcb->next == NULL);
+    heap_push(q, pcb, edf_less);
+}
+
+// ---------------------
+// Ticket tree for LOTTERY. See queue::ticket_sums.
+// ---------------------
+
+// Recompute ticket_sums for i and every ancestor of i.
+static void ticket_tree_fix_up(struct queue *q, size_t i) {
+    while (1) {
+        size_t l = 2 * i + 1, r = l + 1;
+        size_t sum = q->heap[i]->weight;
+        if (l < q->heap_size) sum += q->ticket_sums[l];
+        if (r < q->heap_size) sum += q->ticket_sums[r];
+        q->ticket_sums[i] = sum;
+        if (i == 0) return;
+        i = (i - 1) / 2;
+    }
+}
+
+void enqueue_lottery(struct queue *q, struct PCB *pcb) {
+    assert(pcb->next == NULL);
+    size_t old_capacity = q->heap_capacity;
+    heap_reserve_one(q);
+    if (q->heap_capacity != old_capacity) {
+        q->ticket_sums = realloc(q->ticket_sums,
+                                 q->heap_capacity * sizeof(size_t));
+    }
+    size_t i = q->heap_size++;
+    q->heap[i] = pcb;
+    q->size++;
+    ticket_tree_fix_up(q, i);
 }
 
 void enqueue_sjf(struct queue *q, struct PCB *pcb) {
     size_t dur = pcb->duration;
+    q->size++;
 
     struct PCB *p = q->head;
     // if the queue was empty, or the head is a longer job than pcb,
     // pcb is just the new head.
     if (!p || p->duration > dur) {
+        if (!p) q->tail = pcb;
         pcb->next = p;
         q->head = pcb;
         return;
@@ -99,6 +299,7 @@ void enqueue_sjf(struct queue *q, struct PCB *pcb) {
     }
     // If we make it to the end, then this is the longest job.
     p->next = pcb;
+    q->tail = pcb;
 }
 
 void enqueue_aging(struct queue *q, struct PCB *pcb) {
@@ -136,6 +337,8 @@ struct PCB *dequeue_typical(struct queue *q) {
     struct PCB *head = q->head;
     // q -> next
     q->head = head->next;
+    if (!q->head) q->tail = NULL;
+    q->size--;
 
     head->next = NULL;
     return head;
@@ -165,3 +368,143 @@ struct PCB *dequeue_aging(struct queue *q) {
 
     return r;
 }
+
+struct PCB *dequeue_predicted(struct queue *q) {
+    if (q->head == NULL) {
+        return NULL;
+    }
+
+    // Find the link that points at the cheapest PCB, so we can unlink it.
+    // The shell input process is never put off, just like under SJF, where
+    // enqueue_ignoring_priority puts it at the head.
+    // Also keep the PCB before it, in case it's the tail.
+    struct PCB **best = &q->head, *before_best = NULL;
+    double best_cost = pcb_predicted_cost(q->head);
+    struct PCB *prev = q->head;
+    for (struct PCB **link = &q->head->next; *link;
+            prev = *link, link = &(*link)->next) {
+        if (pcb_is_shell_input(*best)) break;
+        if (pcb_is_shell_input(*link)) {
+            best = link;
+            before_best = prev;
+            break;
+        }
+        double cost = pcb_predicted_cost(*link);
+        if (cost < best_cost) {
+            best = link;
+            before_best = prev;
+            best_cost = cost;
+        }
+    }
+
+    struct PCB *pcb = *best;
+    *best = pcb->next;
+    if (q->tail == pcb) q->tail = before_best;
+    q->size--;
+    pcb->next = NULL;
+    return pcb;
+}
+
+struct PCB *dequeue_mlfq(struct queue *q) {
+    if (q->head) {
+        return dequeue_typical(q);
+    }
+    for (size_t i = 0; i < MLFQ_MAX_LEVELS; ++i) {
+        struct PCB *head = q->levels[i];
+        if (head) {
+            q->levels[i] = head->next;
+            head->next = NULL;
+            q->size--;
+            return head;
+        }
+    }
+    return NULL;
+}
+
+struct PCB *dequeue_cfs(struct queue *q) {
+    if (q->head) {
+        return dequeue_typical(q);
+    }
+    struct PCB *pcb = heap_pop(q, cfs_less);
+    if (pcb && pcb->vruntime > q->min_vruntime) {
+        q->min_vruntime = pcb->vruntime;
+    }
+    return pcb;
+}
+
+struct PCB *dequeue_edf(struct queue *q) {
+    if (q->head) {
+        return dequeue_typical(q);
+    }
+    return heap_pop(q, edf_less);
+}
+
+// A ticket drawn uniformly from [0, total). rand_r only goes up to
+// RAND_MAX, and taking it mod total would favour the low tickets, so draw
+// as many times as it takes to cover total, and draw again if we land in
+// the incomplete last round of total at the top of the range.
+static size_t draw_ticket(unsigned *seed, size_t total) {
+    const uint64_t base = (uint64_t)RAND_MAX + 1;
+    for (;;) {
+        uint64_t r = 0, range = 1;
+        do {
+            r = r * base + rand_r(seed);
+            range *= base;
+        } while (range < total && range <= UINT64_MAX / base);
+        uint64_t limit = range - range % total;
+        if (r < limit) return r % total;
+    }
+}
+
+struct PCB *dequeue_lottery(struct queue *q) {
+    if (q->head) {
+        return dequeue_typical(q);
+    }
+    if (q->heap_size == 0) {
+        return NULL;
+    }
+
+    // Draw a ticket, then walk down the tree to whoever holds it.
+    size_t ticket = draw_ticket(&q->lottery_seed, q->ticket_sums[0]);
+    size_t i = 0;
+    while (1) {
+        size_t own = q->heap[i]->weight;
+        if (ticket < own) break;
+        ticket -= own;
+        size_t l = 2 * i + 1;
+        // The ticket is in one of the subtrees, so l must exist.
+        if (ticket < q->ticket_sums[l]) {
+            i = l;
+        } else {
+            ticket -= q->ticket_sums[l];
+            i = l + 1;
+        }
+    }
+    struct PCB *winner = q->heap[i];
+
+    // Fill the hole with the last leaf, then fix the sums on the paths
+    // above both the hole and the leaf's old position.
+    q->size--;
+    size_t last = --q->heap_size;
+    if (i != last) {
+        q->heap[i] = q->heap[last];
+        ticket_tree_fix_up(q, i);
+    }
+    if (last > 0) {
+        ticket_tree_fix_up(q, (last - 1) / 2);
+    }
+    return winner;
+}
+
+void boost_mlfq(struct queue *q) {
+    for (size_t i = 1; i < MLFQ_MAX_LEVELS; ++i) {
+        struct PCB *p = q->levels[i];
+        if (!p) continue;
+        // Relabel before splicing, otherwise we'd walk level 0 as well.
+        for (struct PCB *r = p; r; r = r->next) {
+            r->level = 0;
+        }
+        append_to_list(&q->levels[0], p);
+        q->levels[i] = NULL;
+    }
+}
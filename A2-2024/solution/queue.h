@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h> // size_t
 
 // The purpose of our queue is to manage scheduling.
 // Ideally, we'd like to separate scheduling concerns from actually executing
@@ -34,6 +35,11 @@
 // because schedule_policy.h requires this definition.
 struct queue;
 
+// MLFQ keeps one FIFO list per priority level inside the queue.
+// This is the most levels a policy may configure. Also needed by
+// schedule_policy.h.
+#define MLFQ_MAX_LEVELS 8
+
 #include "schedule_policy.h"
 
 // Note: we _could_ make functions in this file that are policy-agnostic,
@@ -48,6 +54,12 @@ struct queue;
 // we could add alloc/dealloc functions to the policy struct and replace
 // struct queue pointers with void pointers everywhere.
 
+// Seed for the lottery draws of every new queue. Change it to get a
+// different (but still repeatable) schedule.
+#ifndef LOTTERY_SEED
+#define LOTTERY_SEED 1
+#endif
+
 struct queue *alloc_queue();
 void free_queue(struct queue *q);
 
@@ -55,11 +67,20 @@ void free_queue(struct queue *q);
 // the queue contents for a given filename.
 int program_already_scheduled(struct queue *q, char *name);
 
+// The number of PCBs on the queue, regardless of which policy put them there.
+// This is O(1), so the scheduler can ask on every slice.
+size_t queue_size(struct queue *q);
+
+// Call fn(pcb, arg) on every PCB on the queue, in no particular order.
+// fn must not modify the queue.
+void queue_for_each(struct queue *q, void (*fn)(struct PCB *, void *), void *arg);
+
 // This particular function is policy-agnostic, but its interface matches
 // the regular enqueue function just to keep things clean.
 void enqueue_ignoring_priority(struct queue *q, struct PCB *pcb);
 
 // FCFS, RR
+// O(1): the queue keeps its tail.
 void enqueue_fcfs(struct queue *q, struct PCB *pcb);
 // SJF
 void enqueue_sjf(struct queue *q, struct PCB *pcb);
@@ -68,7 +89,47 @@ void enqueue_sjf(struct queue *q, struct PCB *pcb);
 // if it's tied with the current head, rather than doing an FCFS tiebreak.
 void enqueue_aging(struct queue *q, struct PCB *pcb);
 
+// MLFQ
+// Appends the given pcb to the tail of the list for pcb->level.
+void enqueue_mlfq(struct queue *q, struct PCB *pcb);
+// CFS
+// Inserts into a min-heap ordered by vruntime, in O(log n).
+void enqueue_cfs(struct queue *q, struct PCB *pcb);
+// EDF
+// Inserts into a min-heap ordered by deadline, in O(log n).
+void enqueue_edf(struct queue *q, struct PCB *pcb);
+// Lottery
+// Adds pcb's tickets (its weight) to the draw, in O(log n).
+void enqueue_lottery(struct queue *q, struct PCB *pcb);
+
 // FCFS, RR, SJF
 struct PCB *dequeue_typical(struct queue *q);
 // Aging
 struct PCB *dequeue_aging(struct queue *q);
+// SJFP
+// Removes the PCB with the smallest predicted cost (see pcb_predicted_cost),
+// with ties broken FCFS. The costs change as the cost model learns, so this
+// has to look at every PCB; enqueue with enqueue_fcfs.
+// The shell input process is always removed first.
+struct PCB *dequeue_predicted(struct queue *q);
+// MLFQ
+// PCBs enqueued with enqueue_ignoring_priority come first (that's how the
+// shell input process gets in ahead of everything), then the head of the
+// highest non-empty level.
+struct PCB *dequeue_mlfq(struct queue *q);
+// Move every PCB on a lower level back up to level 0, keeping them in
+// order of their old level. This is the periodic boost that prevents
+// starvation of long jobs.
+void boost_mlfq(struct queue *q);
+// CFS
+// Like dequeue_mlfq, PCBs enqueued ignoring priority come first. Otherwise,
+// removes the PCB with the smallest vruntime in O(log n).
+struct PCB *dequeue_cfs(struct queue *q);
+// EDF
+// PCBs enqueued ignoring priority come first. Otherwise, removes the PCB
+// with the earliest deadline (ties broken by pid) in O(log n).
+struct PCB *dequeue_edf(struct queue *q);
+// Lottery
+// PCBs enqueued ignoring priority come first. Otherwise, draws one ticket
+// uniformly at random and removes the PCB holding it, in O(log n).
+struct PCB *dequeue_lottery(struct queue *q);
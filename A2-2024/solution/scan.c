@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <string.h>
+#include "scan.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+// The vector kernels compare a whole block of bytes at once, turn the
+// result into a bit mask, and then take the set bits out of it lowest
+// first. The spaces other than ' ' are '\t' through '\r', one range, so
+// they take a subtraction and an unsigned min rather than five compares.
+
+static inline int is_word_end(char c) {
+    return c == ' ' || c == ';' || (c >= '\t' && c <= '\r');
+}
+
+static inline size_t scan_scalar(const char *s, size_t len,
+                                 unsigned short *positions) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (is_word_end(s[i])) positions[count++] = i;
+    }
+    return count;
+}
+
+#ifdef SCAN_X86
+// SSE2 is part of x86-64, so this always works there.
+static inline unsigned word_ends_sse2(const char *block) {
+    const __m128i space = _mm_set1_epi8(' '), semi = _mm_set1_epi8(';');
+    const __m128i tab = _mm_set1_epi8('\t'), range = _mm_set1_epi8('\r' - '\t');
+    __m128i v = _mm_loadu_si128((const __m128i *)block);
+    // v - '\t' is at most '\r' - '\t', unsigned, only for '\t'..'\r'.
+    __m128i t = _mm_sub_epi8(v, tab);
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, semi)),
+        _mm_cmpeq_epi8(_mm_min_epu8(t, range), t));
+    return _mm_movemask_epi8(hits);
+}
+
+// Only call this if the CPU has AVX2.
+__attribute__((target("avx2")))
+static inline unsigned word_ends_avx2(const char *block) {
+    const __m256i space = _mm256_set1_epi8(' '), semi = _mm256_set1_epi8(';');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8('\r' - '\t');
+    __m256i v = _mm256_loadu_si256((const __m256i *)block);
+    __m256i t = _mm256_sub_epi8(v, tab);
+    __m256i hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                        _mm256_cmpeq_epi8(v, semi)),
+        _mm256_cmpeq_epi8(_mm256_min_epu8(t, range), t));
+    return _mm256_movemask_epi8(hits);
+}
+
+// Most lines are shorter than a couple of blocks, so the last part of one
+// isn't left to a byte-at-a-time loop: it's copied into a block padded
+// with NULs, which aren't word ends, and compared like the rest. That way
+// nothing past len is read, either.
+#define SCAN_BLOCKS(width, word_ends)                                         \
+    do {                                                                    \
+        size_t count = 0, i = 0;                                            \
+        for (; i < len; i += width) {                                       \
+            const char *block = s + i;                                      \
+            char padded[width];                                             \
+            if (len - i < width) {                                          \
+                memset(padded, 0, width);                                   \
+                memcpy(padded, block, len - i);                             \
+                block = padded;                                             \
+            }                                                               \
+            for (unsigned mask = word_ends(block); mask; mask &= mask - 1) { \
+                positions[count++] = i + __builtin_ctz(mask);               \
+            }                                                               \
+        }                                                                   \
+        return count;                                                       \
+    } while (0)
+
+static size_t scan_sse2(const char *s, size_t len, unsigned short *positions) {
+    SCAN_BLOCKS(16, word_ends_sse2);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *s, size_t len, unsigned short *positions) {
+    SCAN_BLOCKS(32, word_ends_avx2);
+}
+#endif
+
+size_t scan_word_ends(const char *s, size_t len, unsigned short *positions) {
+    assert(len <= MAX_SCAN_SIZE);
+#ifdef SCAN_X86
+    // The CPU is identified once, by libgcc at startup, so this is only a
+    // load and a test.
+    if (__builtin_cpu_supports("avx2")) return scan_avx2(s, len, positions);
+    return scan_sse2(s, len, positions);
+#else
+    return scan_scalar(s, len, positions);
+#endif
+}
@@ -1,57 +1,307 @@
+#include <ctype.h> // isdigit
+#include <stdio.h>
+#include <stdlib.h> // strtoul, qsort
 #include <string.h>
 #include "interpreter.h"
+#include "pcb.h"
 #include "schedule_policy.h"
+#include "timing.h"
 
-#define MAKE_PREEMPTIVE_FN(n)                        \
-  struct PCB * run_steps_##n (struct PCB *pcb) {     \
-    return run_pcb_for_n_steps(pcb, n);              \
-  }
+// ---------------------
+// run_pcb implementations. These read their parameters from the policy.
+// ---------------------
 
-MAKE_PREEMPTIVE_FN(1)
-MAKE_PREEMPTIVE_FN(2)
-MAKE_PREEMPTIVE_FN(30)
+static struct PCB *run_to_completion(struct schedule_policy *policy,
+                                     struct PCB *pcb) {
+    return run_pcb_to_completion(pcb, policy->learns_costs);
+}
+
+static struct PCB *run_quantum(struct schedule_policy *policy,
+                               struct PCB *pcb) {
+    return run_pcb_for_n_steps(pcb, policy->quantum, policy->learns_costs);
+}
 
-const struct schedule_policy FCFS = {
-    .run_pcb = run_pcb_to_completion,
+static const struct schedule_policy FCFS = {
+    .run_pcb = run_to_completion,
     .enqueue = enqueue_fcfs,
     .dequeue = dequeue_typical,
     .enqueue_ignoring_priority = enqueue_ignoring_priority
 };
 
-const struct schedule_policy SJF = {
-    .run_pcb = run_pcb_to_completion,
+static const struct schedule_policy SJF = {
+    .run_pcb = run_to_completion,
     .enqueue = enqueue_sjf,
     .dequeue = dequeue_typical,
     .enqueue_ignoring_priority = enqueue_ignoring_priority
 };
 
-const struct schedule_policy RR = {
-    .run_pcb = run_steps_2,
+static const struct schedule_policy SJFP = {
+    .run_pcb = run_to_completion,
     .enqueue = enqueue_fcfs,
-    .dequeue = dequeue_typical,
-    .enqueue_ignoring_priority = enqueue_ignoring_priority
+    .dequeue = dequeue_predicted,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .learns_costs = 1
 };
 
-const struct schedule_policy RR30 = {
-    .run_pcb = run_steps_30,
+// RR, RR30 and every other RR<n>; get_policy fills in the quantum.
+static const struct schedule_policy RR = {
+    .run_pcb = run_quantum,
     .enqueue = enqueue_fcfs,
     .dequeue = dequeue_typical,
-    .enqueue_ignoring_priority = enqueue_ignoring_priority
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .quantum = 2
 };
 
-const struct schedule_policy AGING = {
-    .run_pcb = run_steps_1,
+static const struct schedule_policy AGING = {
+    .run_pcb = run_quantum,
     .enqueue = enqueue_aging,
     .dequeue = dequeue_aging,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .quantum = 1
+};
+
+static struct PCB *run_adaptive(struct schedule_policy *policy,
+                                struct PCB *pcb) {
+    size_t quantum = policy->quantum;
+    // If the PCB finishes, it is freed, so work out how much it would run
+    // for in that case now.
+    size_t remaining = pcb->line_count - pcb->pc;
+    // The shell input process "bursts" for the rest of the batch file,
+    // which says nothing about the scripts, so don't learn from it.
+    int observe = !pcb_is_shell_input(pcb);
+
+    pcb = run_pcb_for_n_steps(pcb, quantum, policy->learns_costs);
+
+    if (observe) {
+        // A PCB that finished within its slice had a burst of exactly what
+        // it ran. One that was preempted had a longer burst than the
+        // quantum, but we can't tell by how much; guess double, so the
+        // quantum grows quickly toward bursts that don't fit.
+        size_t burst = pcb ? 2 * quantum : remaining;
+        policy->quantum = (quantum + burst) / 2;
+        if (policy->quantum < 1) policy->quantum = 1;
+        if (policy->quantum > ADAPTIVE_MAX_QUANTUM) {
+            policy->quantum = ADAPTIVE_MAX_QUANTUM;
+        }
+    }
+    return pcb;
+}
+
+static const struct schedule_policy ARR = {
+    .run_pcb = run_adaptive,
+    .enqueue = enqueue_fcfs,
+    .dequeue = dequeue_typical,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    // The starting quantum, before anything has been observed.
+    .quantum = 2
+};
+
+static struct PCB *run_mlfq(struct schedule_policy *policy,
+                            struct PCB *pcb) {
+    size_t quantum = policy->quanta[pcb->level];
+    size_t start = pcb->pc;
+    // If the PCB finishes, it is freed, so work out how much it would run
+    // for in that case now.
+    size_t remaining = pcb->line_count - pcb->pc;
+
+    pcb = run_pcb_for_n_steps(pcb, quantum, policy->learns_costs);
+
+    policy->ticks += pcb ? pcb->pc - start : remaining;
+    // Used the whole quantum, so it's not interactive: demote it.
+    // The shell input process is exempt so that commands typed after
+    // `exec ... MLFQ #` are never stuck behind batch jobs.
+    if (pcb && pcb->pc - start >= quantum && !pcb_is_shell_input(pcb)
+            && pcb->level + 1 < policy->levels) {
+        pcb->level++;
+    }
+    return pcb;
+}
+
+static void boost_mlfq_when_due(struct schedule_policy *policy,
+                                struct queue *q) {
+    if (policy->ticks >= MLFQ_BOOST_INTERVAL) {
+        boost_mlfq(q);
+        policy->ticks = 0;
+    }
+}
+
+static const struct schedule_policy MLFQ = {
+    .run_pcb = run_mlfq,
+    .enqueue = enqueue_mlfq,
+    .dequeue = dequeue_mlfq,
+    .before_dequeue = boost_mlfq_when_due,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .levels = 3,
+    .quanta = {2, 4, 8}
+};
+
+// The slice depends on how many PCBs are runnable, which only the dequeue
+// side can see, so work it out then and keep it in the quantum.
+static void set_cfs_slice(struct schedule_policy *policy, struct queue *q) {
+    // This counts the PCB we're about to take off the queue, too.
+    size_t runnable = queue_size(q);
+    if (runnable == 0) return;
+    policy->quantum = CFS_TARGET_LATENCY / runnable;
+    if (policy->quantum < CFS_MIN_GRANULARITY) {
+        policy->quantum = CFS_MIN_GRANULARITY;
+    }
+}
+
+static struct PCB *run_cfs(struct schedule_policy *policy,
+                           struct PCB *pcb) {
+    size_t start = pcb->pc;
+    pcb = run_pcb_for_n_steps(pcb, policy->quantum, policy->learns_costs);
+    if (pcb) {
+        pcb->vruntime += (pcb->pc - start) * VRUNTIME_SCALE / pcb->weight;
+    }
+    return pcb;
+}
+
+static const struct schedule_policy CFS = {
+    .run_pcb = run_cfs,
+    .enqueue = enqueue_cfs,
+    .dequeue = dequeue_cfs,
+    .before_dequeue = set_cfs_slice,
     .enqueue_ignoring_priority = enqueue_ignoring_priority
 };
 
-const struct schedule_policy *get_policy(const char *policy_name) {
-    if (strcmp(policy_name, "FCFS")  == 0) return &FCFS;
-    if (strcmp(policy_name, "SJF")   == 0) return &SJF;
-    if (strcmp(policy_name, "RR")    == 0) return &RR;
-    if (strcmp(policy_name, "RR30")  == 0) return &RR30;
-    if (strcmp(policy_name, "AGING") == 0) return &AGING;
+// Stride scheduling is CFS with a fixed quantum: the pass value is the
+// vruntime, and the stride is VRUNTIME_SCALE / tickets.
+static const struct schedule_policy STRIDE = {
+    .run_pcb = run_cfs,
+    .enqueue = enqueue_cfs,
+    .dequeue = dequeue_cfs,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .quantum = TICKET_QUANTUM
+};
+
+static const struct schedule_policy LOTTERY = {
+    .run_pcb = run_quantum,
+    .enqueue = enqueue_lottery,
+    .dequeue = dequeue_lottery,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .quantum = TICKET_QUANTUM
+};
+
+static struct PCB *run_edf(struct schedule_policy *policy,
+                           struct PCB *pcb) {
+    // The PCB is freed if it finishes, which it can only do in this slice
+    // if its last line is within reach, so only then is there anything to
+    // report. Its name outlives it in the exit history (see free_pcb), so
+    // there's no need to copy it.
+    uint64_t deadline = pcb->deadline;
+    const char *name = deadline != PCB_NO_DEADLINE
+            && pcb->pc + policy->quantum >= pcb->line_count ? pcb->name : NULL;
+
+    pcb = run_pcb_for_n_steps(pcb, policy->quantum, policy->learns_costs);
+
+    if (!pcb && name && monotonic_ns() > deadline) {
+        printf("Deadline missed: %s\n", name);
+        policy->deadline_misses++;
+    }
+    return pcb;
+}
+
+struct admission {
+    struct PCB **pcbs;
+    size_t count;
+};
+
+static void collect_for_admission(struct PCB *pcb, void *arg) {
+    struct admission *a = arg;
+    a->pcbs[a->count++] = pcb;
+}
+
+static int deadline_compare(const void *a, const void *b) {
+    const struct PCB *x = *(struct PCB *const *)a, *y = *(struct PCB *const *)b;
+    if (x->deadline != y->deadline) return x->deadline < y->deadline ? -1 : 1;
+    return x->pid < y->pid ? -1 : x->pid > y->pid;
+}
+
+static void check_edf_admission(struct queue *q) {
+    struct admission a = { malloc(queue_size(q) * sizeof(struct PCB *)), 0 };
+    queue_for_each(q, collect_for_admission, &a);
+    qsort(a.pcbs, a.count, sizeof(struct PCB *), deadline_compare);
+
+    // EDF runs them in this order, so each one finishes once everything
+    // before it, and itself, has run.
+    double finish = monotonic_ns();
+    for (size_t i = 0; i < a.count; ++i) {
+        finish += pcb_predicted_cost(a.pcbs[i]);
+        if (a.pcbs[i]->deadline != PCB_NO_DEADLINE
+                && finish > a.pcbs[i]->deadline) {
+            printf("Warning: %s is predicted to miss its deadline\n",
+                   a.pcbs[i]->name);
+        }
+    }
+    free(a.pcbs);
+}
+
+static const struct schedule_policy EDF = {
+    .run_pcb = run_edf,
+    .enqueue = enqueue_edf,
+    .dequeue = dequeue_edf,
+    .enqueue_ignoring_priority = enqueue_ignoring_priority,
+    .check_admission = check_edf_admission,
+    .quantum = 2,
+    .learns_costs = 1
+};
+
+// Parse a positive decimal number from the start of str.
+// Returns 0 if there isn't one. *end is set to the first unparsed character.
+static size_t parse_count(const char *str, const char **end) {
+    if (!isdigit((unsigned char)*str)) {
+        *end = str;
+        return 0;
+    }
+    char *e;
+    unsigned long n = strtoul(str, &e, 10);
+    *end = e;
+    return n;
+}
+
+// Parse the optional quanta list of "MLFQ" or "MLFQ:q0,q1,...".
+// Returns 0 on success, non-zero if the name is malformed.
+static int configure_mlfq(const char *params, struct schedule_policy *policy) {
+    if (*params == '\0') return 0;
+    if (*params++ != ':') return 1;
+
+    policy->levels = 0;
+    while (1) {
+        const char *end;
+        size_t quantum = parse_count(params, &end);
+        if (quantum == 0) return 1;
+        if (policy->levels == MLFQ_MAX_LEVELS) return 1;
+        policy->quanta[policy->levels++] = quantum;
+
+        if (*end == '\0') return 0;
+        if (*end != ',') return 1;
+        params = end + 1;
+    }
+}
+
+int get_policy(const char *policy_name, struct schedule_policy *policy) {
+    if (strcmp(policy_name, "FCFS")    == 0) { *policy = FCFS;    return 0; }
+    if (strcmp(policy_name, "SJF")     == 0) { *policy = SJF;     return 0; }
+    if (strcmp(policy_name, "SJFP")    == 0) { *policy = SJFP;    return 0; }
+    if (strcmp(policy_name, "AGING")   == 0) { *policy = AGING;   return 0; }
+    if (strcmp(policy_name, "ARR")     == 0) { *policy = ARR;     return 0; }
+    if (strcmp(policy_name, "CFS")     == 0) { *policy = CFS;     return 0; }
+    if (strcmp(policy_name, "STRIDE")  == 0) { *policy = STRIDE;  return 0; }
+    if (strcmp(policy_name, "LOTTERY") == 0) { *policy = LOTTERY; return 0; }
+    if (strcmp(policy_name, "EDF")     == 0) { *policy = EDF;     return 0; }
+    if (strncmp(policy_name, "MLFQ", 4) == 0) {
+        *policy = MLFQ;
+        return configure_mlfq(policy_name + 4, policy);
+    }
+    if (strncmp(policy_name, "RR", 2) == 0) {
+        // Plain "RR" keeps the default quantum; "RR<n>" uses n.
+        *policy = RR;
+        if (policy_name[2] == '\0') return 0;
+        const char *end;
+        policy->quantum = parse_count(policy_name + 2, &end);
+        return policy->quantum == 0 || *end != '\0';
+    }
 
-    return NULL;
+    return 1;
 }
@@ -6,7 +6,9 @@
 struct schedule_policy {
     // Run the given PCB. Return the given PCB if it should be re-scheduled,
     // otherwise clean up the PCB and return NULL.
-    struct PCB *(*run_pcb)(struct PCB*);
+    // The policy is passed along so that this can read its parameters
+    // and update its state.
+    struct PCB *(*run_pcb)(struct schedule_policy*, struct PCB*);
     // Enqueue the given PCB. If this policy is a priority queue (e.g. SJF),
     // the PCB may not end up at the tail of the queue.
     void (*enqueue)(struct queue*, struct PCB*);
@@ -16,14 +18,87 @@ struct schedule_policy {
     // If an operation such as aging is to be performed on other members,
     // it is done at this time.
     struct PCB *(*dequeue)(struct queue*);
+    // Optional; NULL for most policies. Called before every dequeue, for
+    // policies that need to look at (or rearrange) the whole queue first.
+    void (*before_dequeue)(struct schedule_policy*, struct queue*);
+    // Optional; NULL for most policies. Called by exec once it has enqueued
+    // its scripts, to report on whether the schedule can work out.
+    void (*check_admission)(struct queue*);
+
+    // Parameters, filled in by get_policy from the policy name. Each policy
+    // only looks at the ones that it uses.
+
+    // Instructions per slice, for RR<n>, AGING, STRIDE, LOTTERY and EDF.
+    // For ARR, the slice it starts with.
+    size_t quantum;
+    // MLFQ: the number of levels and the quantum of each.
+    size_t levels;
+    size_t quanta[MLFQ_MAX_LEVELS];
+    // SJFP and EDF: the policy schedules by predicted cost, so every line
+    // it runs is timed to train the cost model (see command.h). The other
+    // policies don't read the clock between slices.
+    int learns_costs;
+
+    // State. Every copy made by get_policy starts it afresh, so two
+    // schedules that use the same policy don't interfere.
+
+    // MLFQ: instructions executed since the last boost.
+    size_t ticks;
+    // EDF: processes that finished after their deadline.
+    size_t deadline_misses;
+    // ARR and CFS also adjust quantum as they go.
 };
 
-const struct schedule_policy *get_policy(const char *policy_name);
+// Number of instructions MLFQ executes between boosting every process
+// back to the top level.
+#ifndef MLFQ_BOOST_INTERVAL
+#define MLFQ_BOOST_INTERVAL 50
+#endif
+
+// CFS gives every runnable process a slice of
+// CFS_TARGET_LATENCY / (number of runnable processes) instructions,
+// but never less than CFS_MIN_GRANULARITY.
+#ifndef CFS_TARGET_LATENCY
+#define CFS_TARGET_LATENCY 24
+#endif
+#ifndef CFS_MIN_GRANULARITY
+#define CFS_MIN_GRANULARITY 1
+#endif
+
+// STRIDE and LOTTERY run every process for this many instructions at a time.
+#ifndef TICKET_QUANTUM
+#define TICKET_QUANTUM 1
+#endif
+
+// ARR never lets its slice grow beyond this many instructions.
+#ifndef ADAPTIVE_MAX_QUANTUM
+#define ADAPTIVE_MAX_QUANTUM 30
+#endif
+
+// Fill in *policy for the given policy name, parameters included.
+// Returns 0 on success, or non-zero if the name isn't a valid policy.
+int get_policy(const char *policy_name, struct schedule_policy *policy);
+
 
 // Notes on particular policies:
 //
+// RR:
+//  "RR<n>" runs each process for n instructions at a time; "RR" means RR2.
+//  So RR30 is just one instance of this.
+// ARR:
+//  Round robin whose quantum is a moving average of the observed CPU burst
+//  lengths, capped at ADAPTIVE_MAX_QUANTUM. A process that finishes within
+//  its slice contributes the length it ran; one that is preempted
+//  contributes twice the quantum, since its burst didn't fit.
+//
 // SJF:
 //  Ties are broken via FCFS.
+// SJFP:
+//  Like SJF, but a job's length is its predicted cost rather than its line
+//  count. Each command has a cost estimate, learned at runtime by timing
+//  every line that SJFP and EDF run (see command.h), so one `run` line
+//  counts for far more than one `echo` line. The prediction is made when
+//  the job is picked, so it uses everything measured up to that point.
 // Aging:
 //  Except when first scheduling a PCB, ties at the head are broken by
 //  enqueuing directly to the head.
@@ -32,3 +107,38 @@ const struct schedule_policy *get_policy(const char *policy_name);
 //
 //  Otherwise (tie not at the head, or during first scheduling),
 //  we break ties with FCFS like SJF.
+//
+// MLFQ:
+//  Named "MLFQ" for the default three levels with quanta 2, 4 and 8, or
+//  "MLFQ:q0,q1,..." to pick the number of levels (up to MLFQ_MAX_LEVELS)
+//  and the quantum of each one.
+//  A PCB that uses its whole quantum is demoted one level. Every
+//  MLFQ_BOOST_INTERVAL instructions, all PCBs are boosted back to level 0.
+//  The shell input process (exec ... #) is never demoted.
+//
+// CFS:
+//  Always runs the PCB with the smallest vruntime, ties broken by pid.
+//  Runnable PCBs are kept in a min-heap, so picking one is O(log n) however
+//  many scripts are running. A process given `exec prog:w` has weight w and
+//  accumulates vruntime w times slower, so it gets w times the share.
+//
+// STRIDE and LOTTERY:
+//  `exec prog:t ...` gives prog t tickets (1 by default), and each process
+//  runs for TICKET_QUANTUM instructions at a time. Over time, a process gets
+//  a share of instructions proportional to its tickets: `exec a:70 b:20 c:10`
+//  splits the interpreter 70/20/10.
+//  STRIDE is deterministic. It always runs the smallest pass (kept in the
+//  CFS heap) and advances it by VRUNTIME_SCALE / tickets.
+//  LOTTERY draws a ticket at random on every dispatch. The draw is O(log n)
+//  and seeded with LOTTERY_SEED, so a given run is still repeatable.
+//
+// EDF:
+//  Runs the process with the earliest deadline, given as `exec prog@ms ...`,
+//  for two instructions at a time, so that a background exec with an
+//  earlier deadline can preempt. Processes without a deadline run last.
+//  The ready processes are kept in a min-heap, so dispatch is O(log n).
+//  Admission: once exec has queued its scripts, the predicted costs (see
+//  SJFP) are added up in deadline order, and exec warns about every
+//  process that would finish after its deadline. The scripts still run.
+//  Every process that really does finish late is reported and counted in
+//  deadline_misses.
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pcb.h"
+#include "ps.h"
+#include "scheduler.h"
+#include "timing.h"
+#include "trace.h"
+#include "jobs.h"
+
+// The groups, in the order they were added.
+// Groups are added at the tail while run_groups is going; a background exec
+// runs from inside one of the group's dispatches. That's why run_groups
+// re-reads `next` after every turn, rather than keeping an array.
+static struct sched_group *groups = NULL;
+
+struct sched_group *alloc_group(const struct schedule_policy *policy,
+                                size_t weight) {
+    struct sched_group *group = malloc(sizeof(struct sched_group));
+    group->policy = *policy;
+    group->q = alloc_queue();
+    group->weight = weight ? weight : 1;
+    group->pending = group->pending_tail = NULL;
+    group->blocked = NULL;
+    group->next = NULL;
+    return group;
+}
+
+void free_group(struct sched_group *group) {
+    free_queue(group->q);
+    while (group->pending) {
+        struct PCB *pcb = group->pending;
+        group->pending = pcb->next;
+        free_pcb(pcb);
+    }
+    while (group->blocked) {
+        struct PCB *pcb = group->blocked;
+        group->blocked = pcb->next;
+        free_pcb(pcb);
+    }
+    free(group);
+}
+
+void add_group(struct sched_group *group) {
+    struct sched_group **tail = &groups;
+    while (*tail) tail = &(*tail)->next;
+    *tail = group;
+}
+
+int program_scheduled_in_group(struct sched_group *group, char *name) {
+    if (program_already_scheduled(group->q, name)) return 1;
+    for (struct PCB *pcb = group->pending; pcb; pcb = pcb->next) {
+        if (strcmp(pcb->name, name) == 0) return 1;
+    }
+    for (struct PCB *pcb = group->blocked; pcb; pcb = pcb->next) {
+        if (strcmp(pcb->name, name) == 0) return 1;
+    }
+    return 0;
+}
+
+int program_scheduled_in_any_group(char *name) {
+    for (struct sched_group *g = groups; g; g = g->next) {
+        if (program_scheduled_in_group(g, name)) return 1;
+    }
+    return 0;
+}
+
+// ---------------------
+// Admission. A process can only run once its code is in the line memory.
+// If there isn't room, it waits on its group's pending list, and processes
+// are admitted strictly in the order they were submitted (groups are in exec
+// order, and each pending list is FIFO), whenever a process exits.
+// ---------------------
+
+static void defer_admission(struct sched_group *group, struct PCB *pcb) {
+    pcb->next = NULL;
+    if (group->pending_tail) group->pending_tail->next = pcb;
+    else                     group->pending = pcb;
+    group->pending_tail = pcb;
+    trace_event(TRACE_BLOCK, pcb->pid, NULL);
+}
+
+static int anything_pending(void) {
+    for (struct sched_group *g = groups; g; g = g->next) {
+        if (g->pending) return 1;
+    }
+    return 0;
+}
+
+// Admit the pending processes of group, in order, until one doesn't fit.
+// Returns 0 if they were all admitted, non-zero if some still wait.
+static int admit_pending_of(struct sched_group *group) {
+    while (group->pending) {
+        struct PCB *pcb = group->pending;
+        if (pcb_load(pcb)) return 1;
+        group->pending = pcb->next;
+        if (!group->pending) group->pending_tail = NULL;
+        pcb->next = NULL;
+        group->policy.enqueue(group->q, pcb);
+    }
+    return 0;
+}
+
+// Admit whatever fits now, oldest first.
+static void admit_pending(void) {
+    for (struct sched_group *g = groups; g; g = g->next) {
+        if (admit_pending_of(g)) return;
+    }
+}
+
+// Give up on the group's pending processes; nothing can make room for them.
+static void reject_pending_of(struct sched_group *group) {
+    while (group->pending) {
+        struct PCB *pcb = group->pending;
+        group->pending = pcb->next;
+        printf("Failed to create process\n");
+        free_pcb(pcb);
+    }
+    group->pending_tail = NULL;
+}
+
+void submit_process(struct sched_group *group, struct PCB *pcb) {
+    if (!group->pending && !anything_pending() && pcb_load(pcb) == 0) {
+        group->policy.enqueue(group->q, pcb);
+    } else {
+        defer_admission(group, pcb);
+    }
+}
+
+static int group_is_done(struct sched_group *group) {
+    return queue_size(group->q) == 0 && !group->pending && !group->blocked;
+}
+
+// ---------------------
+// Blocking. A process that runs `wait` while its job is still going comes
+// back from run_pcb with waiting_for_job set. It goes on its group's
+// blocked list instead of the queue, and back on the queue once the job
+// has exited. Job exits are only noticed when jobs_poll looks for them,
+// which is cheap (and skipped entirely when no job is running).
+// ---------------------
+
+static size_t blocked_processes = 0;
+
+static void block(struct sched_group *group, struct PCB *pcb) {
+    pcb->next = group->blocked;
+    group->blocked = pcb;
+    blocked_processes++;
+}
+
+// Put the group's blocked processes whose jobs are done back on its queue.
+static void wake_blocked_of(struct sched_group *group) {
+    struct PCB **link = &group->blocked;
+    while (*link) {
+        struct PCB *pcb = *link;
+        if (job_is_running(pcb->waiting_for_job)) {
+            link = &pcb->next;
+            continue;
+        }
+        *link = pcb->next;
+        pcb->next = NULL;
+        blocked_processes--;
+        // The wait is over, so the job has been dealt with.
+        job_forget(pcb->waiting_for_job);
+        pcb->waiting_for_job = 0;
+        pcb->stats.ready_since = monotonic_ns();
+        group->policy.enqueue(group->q, pcb);
+    }
+}
+
+// Notice any jobs that have exited, waiting up to timeout_ms for one if
+// asked to, and wake up the processes that were waiting for them.
+static void wake_blocked(int timeout_ms) {
+    if (!blocked_processes) return;
+    jobs_poll(timeout_ms);
+    for (struct sched_group *g = groups; g; g = g->next) wake_blocked_of(g);
+}
+
+// The PCB being run, and the pid of the last one to be dispatched,
+// for accounting context switches.
+static struct PCB *running = NULL;
+static pid last_dispatched = 0;
+
+struct PCB *running_pcb(void) {
+    return running;
+}
+
+// Dispatch one PCB of the group, if it has any.
+// Returns 0 if the group's queue was empty, 1 otherwise.
+// If steps isn't NULL, the number of instructions run is stored there.
+static int dispatch(struct sched_group *group, size_t *steps) {
+    struct schedule_policy *policy = &group->policy;
+    if (policy->before_dequeue) policy->before_dequeue(policy, group->q);
+    struct PCB *pcb = policy->dequeue(group->q);
+    if (!pcb) return 0;
+    // If the process finishes, it's gone by the time we could look at it,
+    // but then it ran everything it had left.
+    size_t pc_before = pcb->pc, line_count = pcb->line_count;
+
+    // This is a slice boundary, so this is where the clock gets read.
+    pcb->stats.ready_ns += monotonic_ns() - pcb->stats.ready_since;
+    pcb->stats.quanta++;
+    if (pcb->pid != last_dispatched) pcb->stats.context_switches++;
+    last_dispatched = pcb->pid;
+    // A nested run dispatches from inside this one, so put back whatever
+    // was running before rather than clearing it.
+    struct PCB *outer = running;
+    running = pcb;
+    // run_pcb frees the PCB if it finishes, so keep the pid for the trace.
+    pid id = pcb->pid;
+    trace_event(TRACE_DISPATCH, id,
+                pcb_is_shell_input(pcb) ? "(shell)" : pcb->name);
+
+    pcb = policy->run_pcb(policy, pcb);
+
+    running = outer;
+    if (steps) *steps = (pcb ? pcb->pc : line_count) - pc_before;
+    if (pcb && pcb->waiting_for_job) {
+        // The slice is over, like any other that doesn't finish the
+        // process; only then does it block.
+        trace_event(TRACE_PREEMPT, id, NULL);
+        trace_event(TRACE_BLOCK, id, NULL);
+        block(group, pcb);
+    } else if (pcb) {
+        trace_event(TRACE_PREEMPT, id, NULL);
+        pcb->stats.ready_since = monotonic_ns();
+        policy->enqueue(group->q, pcb);
+    } else {
+        trace_event(TRACE_EXIT, id, NULL);
+    }
+    top_refresh();
+    return 1;
+}
+
+// Run a single group to completion, by itself, then free it.
+static void run_group_alone(struct sched_group *group) {
+    while (!group_is_done(group)) {
+        admit_pending();
+        wake_blocked(0);
+        if (dispatch(group, NULL)) continue;
+        if (group->blocked) {
+            // Nothing of ours can run until a job exits.
+            wake_blocked(-1);
+        } else {
+            // Nothing of ours is runnable, and what's pending doesn't fit.
+            // Only the groups we're nested in could free up room, and they
+            // are waiting for us, so it never will.
+            reject_pending_of(group);
+        }
+    }
+    struct sched_group **link = &groups;
+    while (*link != group) link = &(*link)->next;
+    *link = group->next;
+    free_group(group);
+}
+
+void run_groups(void) {
+    // A top-level exec from inside a script (e.g. `run` in a script that is
+    // already scheduled) mustn't start a second round robin over the
+    // groups, because the outer one is in the middle of dispatching.
+    // Treat the newest group like a subroutine call instead.
+    static int running_groups = 0;
+    if (running_groups) {
+        struct sched_group *newest = groups;
+        while (newest->next) newest = newest->next;
+        run_group_alone(newest);
+        return;
+    }
+    running_groups = 1;
+
+    // Remember that groups might be appended during any dispatch,
+    // so only ever look at `next` after the group's turn.
+    struct sched_group **link = &groups;
+    int ran_this_round = 0;
+    while (groups) {
+        if (!*link) {
+            // wrap around for the next round
+            link = &groups;
+            if (!ran_this_round && blocked_processes) {
+                // Everything that could run is waiting for a job, so
+                // sleep until one exits.
+                wake_blocked(-1);
+            } else if (!ran_this_round) {
+                // Every group is waiting for admission, which means that
+                // nothing is loaded, and still the oldest doesn't fit.
+                // That can't happen, since create_process rejects scripts
+                // bigger than all of shellmemory, but don't loop forever.
+                reject_pending_of(groups);
+            }
+            ran_this_round = 0;
+        }
+        admit_pending();
+        wake_blocked(0);
+
+        struct sched_group *group = *link;
+        int ran = 1;
+        for (size_t i = 0; i < group->weight && ran; ++i) {
+            ran = dispatch(group, NULL);
+            if (ran) ran_this_round = 1;
+        }
+
+        if (group_is_done(group)) {
+            // Done. Unlink it; link then already points at the next group.
+            *link = group->next;
+            free_group(group);
+        } else {
+            link = &group->next;
+        }
+    }
+    running_groups = 0;
+    top_stop();
+}
+
+// ---------------------
+// Simulated multi-CPU runs. Each virtual CPU is a group of its own, so it
+// has its own queue and its own copy of the policy (and so its own MLFQ
+// boost clock, lottery draws, and so on). There is still only one
+// interpreter, so the CPUs take turns: in every round, each CPU with
+// anything to run dispatches once. The round lasts as long as the longest
+// of those slices, and a CPU that ran for less, or not at all, is idle for
+// the rest of it. Time is counted in instructions, so a run is repeatable.
+// ---------------------
+
+struct sim_cpu {
+    struct sched_group *group;
+    // Instructions run in this round's slice.
+    size_t slice;
+    size_t busy, idle;
+    size_t dispatches, migrated_in, migrated_out;
+};
+
+static struct sim_cpu *least_loaded(struct sim_cpu *cpus, size_t count) {
+    struct sim_cpu *best = &cpus[0];
+    for (size_t i = 1; i < count; ++i) {
+        if (queue_size(cpus[i].group->q) < queue_size(best->group->q)) {
+            best = &cpus[i];
+        }
+    }
+    return best;
+}
+
+static struct sim_cpu *most_loaded(struct sim_cpu *cpus, size_t count) {
+    struct sim_cpu *best = &cpus[0];
+    for (size_t i = 1; i < count; ++i) {
+        if (queue_size(cpus[i].group->q) > queue_size(best->group->q)) {
+            best = &cpus[i];
+        }
+    }
+    return best;
+}
+
+// Admit what fits of the group's pending processes, and hand everything on
+// the group's own queue out to the CPUs, each to the least loaded one.
+static void place_arrivals(struct sched_group *group,
+                           struct sim_cpu *cpus, size_t count) {
+    admit_pending_of(group);
+    struct PCB *pcb;
+    while ((pcb = group->policy.dequeue(group->q))) {
+        struct sim_cpu *cpu = least_loaded(cpus, count);
+        cpu->group->policy.enqueue(cpu->group->q, pcb);
+    }
+}
+
+// Move PCBs from the longest queue to the shortest until no two queues
+// differ by more than one. The PCB that moves is the one its old CPU would
+// have run next; it's put wherever the new CPU's policy says it goes.
+static void balance_load(struct sim_cpu *cpus, size_t count) {
+    for (;;) {
+        struct sim_cpu *from = most_loaded(cpus, count);
+        struct sim_cpu *to = least_loaded(cpus, count);
+        if (queue_size(from->group->q) <= queue_size(to->group->q) + 1) return;
+        struct PCB *pcb = from->group->policy.dequeue(from->group->q);
+        to->group->policy.enqueue(to->group->q, pcb);
+        from->migrated_out++;
+        to->migrated_in++;
+    }
+}
+
+static void print_sim_report(struct sim_cpu *cpus, size_t count) {
+    size_t migrations = 0, elapsed = cpus[0].busy + cpus[0].idle;
+    printf("CPU  BUSY  IDLE  UTIL%% DISPATCHES MIGR_IN MIGR_OUT\n");
+    for (size_t i = 0; i < count; ++i) {
+        struct sim_cpu *cpu = &cpus[i];
+        printf("%3zu %5zu %5zu %6.1f %10zu %7zu %8zu\n",
+               i, cpu->busy, cpu->idle,
+               elapsed ? 100.0 * cpu->busy / elapsed : 0.0,
+               cpu->dispatches, cpu->migrated_in, cpu->migrated_out);
+        migrations += cpu->migrated_out;
+    }
+    printf("%zu CPUs, %zu instructions elapsed, %zu migrations\n",
+           count, elapsed, migrations);
+}
+
+void run_group_simulated(struct sched_group *group, size_t cpu_count) {
+    struct sim_cpu *cpus = calloc(cpu_count, sizeof(struct sim_cpu));
+    for (size_t i = 0; i < cpu_count; ++i) {
+        cpus[i].group = alloc_group(&group->policy, 1);
+    }
+
+    place_arrivals(group, cpus, cpu_count);
+    for (size_t round = 1; ; ++round) {
+        size_t longest = 0;
+        int ran = 0;
+        for (size_t i = 0; i < cpu_count; ++i) {
+            cpus[i].slice = 0;
+            if (dispatch(cpus[i].group, &cpus[i].slice)) {
+                cpus[i].dispatches++;
+                ran = 1;
+            }
+            if (cpus[i].slice > longest) longest = cpus[i].slice;
+        }
+        for (size_t i = 0; i < cpu_count; ++i) {
+            cpus[i].busy += cpus[i].slice;
+            cpus[i].idle += longest - cpus[i].slice;
+        }
+
+        // Whatever exited this round may have made room for arrivals.
+        place_arrivals(group, cpus, cpu_count);
+        int blocked = 0;
+        for (size_t i = 0; i < cpu_count; ++i) {
+            if (cpus[i].group->blocked) blocked = 1;
+        }
+        if (blocked) {
+            // A blocked process wakes up on the CPU it blocked on. If no CPU
+            // had anything to run, the simulation can only wait for jobs.
+            jobs_poll(ran ? 0 : -1);
+            for (size_t i = 0; i < cpu_count; ++i) wake_blocked_of(cpus[i].group);
+            ran = 1;
+        }
+        if (!ran) {
+            if (!group->pending
+                    && queue_size(most_loaded(cpus, cpu_count)->group->q) == 0) {
+                break;
+            }
+            // Every CPU was idle, so nothing exited, and the pending
+            // processes still don't fit. They never will.
+            reject_pending_of(group);
+        }
+        if (round % SIM_BALANCE_INTERVAL == 0) balance_load(cpus, cpu_count);
+    }
+
+    print_sim_report(cpus, cpu_count);
+    for (size_t i = 0; i < cpu_count; ++i) free_group(cpus[i].group);
+    free(cpus);
+    free_group(group);
+    top_stop();
+}
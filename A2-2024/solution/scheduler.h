@@ -0,0 +1,71 @@
+#pragma once
+#include <stddef.h>
+#include "queue.h"
+#include "schedule_policy.h"
+
+// A scheduling group: the scripts from one call to exec, scheduled by the
+// policy that exec was given. Every group has its own queue and its own copy
+// of the policy, so `exec a b RR #` followed by `exec c d FCFS` really does
+// run c and d first-come-first-served, next to a and b in round robin.
+struct sched_group {
+    struct schedule_policy policy;
+    struct queue *q;
+    // Dispatches this group gets for every one that a weight-1 group gets.
+    size_t weight;
+    // Processes that have been submitted, but are waiting for room in
+    // shellmemory, oldest first. Linked through PCB::next.
+    struct PCB *pending, *pending_tail;
+    // Processes that are blocked in `wait` (see PCB::waiting_for_job),
+    // in no particular order. Also linked through PCB::next.
+    struct PCB *blocked;
+    struct sched_group *next;
+};
+
+// Allocate a group with an empty queue. The policy is copied.
+// The group isn't scheduled until it is passed to add_group.
+struct sched_group *alloc_group(const struct schedule_policy *policy,
+                                size_t weight);
+// Free the group, its queue, and every PCB still on the queue, pending or
+// blocked.
+// The group must not have been added, or must have been removed again.
+void free_group(struct sched_group *group);
+
+// Schedule the group. Ownership passes to the scheduler.
+void add_group(struct sched_group *group);
+
+// Hand a new process to the group. If its code fits in shellmemory now and
+// no other process is waiting for admission, it's loaded and enqueued.
+// Otherwise it waits, and is admitted in order as running processes exit.
+void submit_process(struct sched_group *group, struct PCB *pcb);
+
+// Is a script with this name scheduled, or waiting, in the group?
+// Waiting for admission and blocked both count.
+int program_scheduled_in_group(struct sched_group *group, char *name);
+// Is a script with this name scheduled, or waiting, in any added group?
+int program_scheduled_in_any_group(char *name);
+
+// Share the interpreter between the groups until every script of every
+// group, including groups added while this runs, has finished.
+// Groups take turns in the order they were added; in each turn a group
+// dispatches `weight` PCBs using its own policy. Pending processes are
+// admitted as soon as there's room. Finished groups are freed.
+// A process that blocks waiting for a job is set aside until the job exits;
+// if nothing else can run, this sleeps until one does.
+// If the groups are already running, only the newest group is run, to
+// completion, before returning.
+void run_groups(void);
+
+// The process that is running right now, or NULL outside of run_groups.
+struct PCB *running_pcb(void);
+
+// Run the group by itself on cpu_count simulated CPUs, each with its own
+// queue and its own copy of the group's policy, then free it and print
+// each CPU's utilization and migrations. New processes go to the CPU with
+// the shortest queue. The CPUs dispatch in lockstep rounds (see
+// scheduler.c), and every SIM_BALANCE_INTERVAL rounds, PCBs migrate from
+// long queues to short ones. Time is counted in instructions.
+// The group must not have been added.
+void run_group_simulated(struct sched_group *group, size_t cpu_count);
+#ifndef SIM_BALANCE_INTERVAL
+#define SIM_BALANCE_INTERVAL 4
+#endif
@@ -0,0 +1,150 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bytecode.h"
+#include "script.h"
+#include "shell.h" // MAX_USER_INPUT
+
+struct script *script_read(FILE *f) {
+    struct script *script = calloc(1, sizeof(struct script));
+    script->refs = 1;
+
+    // We're told to assume lines of files are limited to 100 characters.
+    // That's all well and good, but for implementing # we need to read
+    // actual user input, and _that_ is limited to 1000 characters.
+    // It's unclear if we should assume it's also limited to 100 for this
+    // purpose. If you did assume that, that's OK! We didn't.
+    char linebuf[MAX_USER_INPUT];
+    size_t capacity = 16;
+    script->lines = malloc(capacity * sizeof(char *));
+    while (!feof(f)) {
+        memset(linebuf, 0, sizeof(linebuf));
+        fgets(linebuf, MAX_USER_INPUT, f);
+
+        if (script->line_count == capacity) {
+            capacity *= 2;
+            script->lines = realloc(script->lines, capacity * sizeof(char *));
+        }
+        script->lines[script->line_count++] = strdup(linebuf);
+    }
+
+    // We're done with the file, don't forget to close it!
+    fclose(f);
+
+    // Classifying and compiling each line once, here, is the whole point:
+    // every process that runs the script gets the results for free.
+    script->commands = malloc(script->line_count * sizeof(enum command));
+    script->code = malloc(script->line_count * sizeof(struct bytecode *));
+    for (size_t i = 0; i < script->line_count; ++i) {
+        script->commands[i] = classify_command(script->lines[i]);
+        script->code[i] = compile_line(script->lines[i]);
+        script->count_by_command[script->commands[i]]++;
+    }
+    return script;
+}
+
+void script_release(struct script *script) {
+    assert(script->refs > 0);
+    if (--script->refs) return;
+    for (size_t i = 0; i < script->line_count; ++i) {
+        free(script->lines[i]);
+        free(script->code[i]);
+    }
+    free(script->lines);
+    free(script->commands);
+    free(script->code);
+    free(script);
+}
+
+// ---------------------
+// The cache. Batch files tend to run the same few scripts over and over, and
+// reading and compiling them again every time is most of the cost of exec.
+// The cache is a list in LRU order; it's only SCRIPT_CACHE_SIZE long, so
+// a linear search is fine, and a hit costs one stat() instead of reading the
+// file. The cache holds a reference to each script in it, so evicting a
+// script that is still running only drops the cache's reference.
+// ---------------------
+
+static struct script *cache_head = NULL, *cache_tail = NULL;
+static size_t cache_count = 0;
+
+static void cache_unlink(struct script *script) {
+    if (script->prev) script->prev->next = script->next;
+    else cache_head = script->next;
+    if (script->next) script->next->prev = script->prev;
+    else cache_tail = script->prev;
+    script->prev = script->next = NULL;
+}
+
+static void cache_push_front(struct script *script) {
+    script->prev = NULL;
+    script->next = cache_head;
+    if (cache_head) cache_head->prev = script;
+    else cache_tail = script;
+    cache_head = script;
+}
+
+static int same_file(const struct script *script, const struct stat *st) {
+    return script->dev == st->st_dev && script->ino == st->st_ino
+        && script->size == st->st_size
+        && script->mtime.tv_sec == st->st_mtim.tv_sec
+        && script->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static void cache_evict(struct script *script) {
+    cache_unlink(script);
+    script->cached = 0;
+    cache_count--;
+    script_release(script);
+}
+
+static void cache_insert(struct script *script, const struct stat *st) {
+    // A file that has changed leaves its old version behind; nothing will
+    // ever match it again, so it may as well go now.
+    for (struct script *s = cache_head; s; s = s->next) {
+        if (s->dev == st->st_dev && s->ino == st->st_ino) {
+            cache_evict(s);
+            break;
+        }
+    }
+    if (cache_count == SCRIPT_CACHE_SIZE) cache_evict(cache_tail);
+
+    script->cached = 1;
+    script->dev = st->st_dev;
+    script->ino = st->st_ino;
+    script->size = st->st_size;
+    script->mtime = st->st_mtim;
+    script->refs++;
+    cache_push_front(script);
+    cache_count++;
+}
+
+struct script *script_open(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) == 0 && S_ISREG(st.st_mode)) {
+        for (struct script *s = cache_head; s; s = s->next) {
+            if (same_file(s, &st)) {
+                cache_unlink(s);
+                cache_push_front(s);
+                s->refs++;
+                return s;
+            }
+        }
+    }
+
+    FILE *f = fopen(filename, "rt");
+    if (!f) return NULL;
+    // Key the script by the file as it is when we read it, not as it was
+    // when we looked it up above, in case it changed in between.
+    // Anything but a regular file (a pipe, say) could read differently
+    // next time, so only regular files are cached.
+    int cacheable = fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode);
+    struct script *script = script_read(f);
+    if (cacheable) cache_insert(script, &st);
+    return script;
+}
+
+void script_cache_clear(void) {
+    while (cache_head) cache_evict(cache_head);
+}
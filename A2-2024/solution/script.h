@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h> // FILE
+#include <sys/types.h>
+#include <time.h>
+#include "command.h"
+
+// A script's code, read from its file and compiled (see bytecode.h) once.
+// Processes running the script share it: pcb_load points the line memory at
+// these lines rather than copying them, so a script is reference counted,
+// and freed when the last process (or the cache) lets go of it.
+struct script {
+    size_t refs;
+    size_t line_count;
+    char **lines;
+    enum command *commands;
+    struct bytecode **code;
+    // How many lines start with each command (see PCB::remaining_by_command).
+    size_t count_by_command[CMD_COUNT];
+
+    // The rest is for the cache. A script that isn't cached has cached = 0.
+    // The file is the same (as far as we can tell without reading it) if
+    // it's the same inode on the same device, and it has the same size and
+    // modification time as when it was read.
+    int cached;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    // The cache's LRU list, most recently used first.
+    struct script *prev, *next;
+};
+
+// How many scripts the cache keeps, whether or not anything is running them.
+// Each is at most MEM_SIZE lines.
+#define SCRIPT_CACHE_SIZE 16
+
+// The script in the named file, from the cache if the file hasn't changed
+// since it was last read, or read and compiled now (and cached) otherwise.
+// The caller gets a reference, for script_release.
+// Returns NULL, and sets errno, if the file can't be opened.
+struct script *script_open(const char *filename);
+// Read and compile a script from f, which could be anything, so it isn't
+// cached. Takes ownership of f and closes it.
+struct script *script_read(FILE *f);
+// Give up a reference from script_open or script_read.
+void script_release(struct script *script);
+// Forget every cached script. Compiled code refers to variables by symbol,
+// so mem_init must do this when it forgets the symbols.
+void script_cache_clear(void);
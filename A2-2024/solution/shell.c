@@ -1,11 +1,86 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h> // isspace
 #include <string.h>
 #include <unistd.h> // isatty
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
 #include "shell.h"
 #include "interpreter.h"
+#include "scan.h"
 #include "shellmemory.h"
+#include "trace.h"
+
+// Batch input. Going through stdio, every byte of the batch file is copied
+// into the FILE's buffer and again into userInput, which is cleared after
+// every line, too. Batch files can be hundreds of MB, so when stdin is a
+// regular file, it is mapped instead, and each line goes to parse_line as a
+// slice of the mapping, with no copying at all. Pipes and terminals can't
+// be mapped, so they still go through fgets.
+// The lines are exactly the ones fgets would have read: a line too long for
+// userInput is split the same way, and eof is set when feof(stdin) would be.
+static struct {
+    const char *map;    // the mapping, or NULL if stdin isn't mapped
+    size_t map_size;
+    const char *data;   // where stdin was when the shell started
+    size_t size, pos;   // how much of it there is, and how much is read
+    off_t start;        // the offset in stdin of data
+    int eof;
+} batch;
+
+static void map_batch_input(void) {
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) || !S_ISREG(st.st_mode)) return;
+    // Something may have read some of stdin before we started; that's not
+    // ours to read again.
+    off_t start = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (start < 0 || start >= st.st_size) return;
+    // mmap wants an offset that's a whole number of pages.
+    off_t map_start = start - start % sysconf(_SC_PAGESIZE);
+    size_t map_size = st.st_size - map_start;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE,
+                     STDIN_FILENO, map_start);
+    if (map == MAP_FAILED) return;
+    madvise(map, map_size, MADV_SEQUENTIAL);
+    // As far as anyone else can tell, we've read it all, the way stdio
+    // would have read ahead a buffer's worth; spawned programs sharing
+    // stdin shouldn't get the batch file over again.
+    lseek(STDIN_FILENO, 0, SEEK_END);
+    batch.map = map;
+    batch.map_size = map_size;
+    batch.data = batch.map + (start - map_start);
+    batch.size = st.st_size - start;
+    batch.pos = 0;
+    batch.start = start;
+    batch.eof = 0;
+}
+
+// The next line of the mapped input, as fgets(userInput, MAX_USER_INPUT-1,
+// stdin) would read it: up to and including a newline, but no more than
+// MAX_USER_INPUT-2 characters. At the end, the line is empty.
+static const char *next_batch_line(size_t *len) {
+    const char *line = batch.data + batch.pos;
+    size_t left = batch.size - batch.pos, max = MAX_USER_INPUT - 2;
+    const char *newline = memchr(line, '\n', left < max ? left : max);
+    if (newline) {
+        *len = newline - line + 1;
+    } else if (left >= max) {
+        // fgets stops when the buffer is full, without looking any further,
+        // so it doesn't see the end of the file even if it's right there.
+        *len = max;
+    } else {
+        *len = left;
+        batch.eof = 1;
+    }
+    batch.pos += *len;
+    return line;
+}
+
+void release_batch_input(void) {
+    if (!batch.map) return;
+    fseek(stdin, batch.start + batch.pos, SEEK_SET);
+    munmap((void *)batch.map, batch.map_size);
+    batch.map = NULL;
+}
 
 // Start of everything
 int main(int argc, char *argv[]) {
@@ -24,36 +99,93 @@ int main(int argc, char *argv[]) {
     
     //init shell memory
     mem_init();
+    trace_init();
+    if (batch_mode) map_batch_input();
     while(1) {
         if (!batch_mode) {
             printf("%c ", prompt);
         }
-        fgets(userInput, MAX_USER_INPUT-1, stdin);
-        errorCode = parseInput(userInput);
+        if (batch.map) {
+            // A NUL ends the line for fgets' caller, too.
+            size_t len;
+            const char *line = next_batch_line(&len);
+            errorCode = parse_line(line, strnlen(line, len));
+        } else {
+            fgets(userInput, MAX_USER_INPUT-1, stdin);
+            errorCode = parseInput(userInput);
+        }
         if (errorCode == -1) exit(99); // ignore all other errors
 
-        if (feof(stdin)) {
+        if (batch.map ? batch.eof : feof(stdin)) {
+            release_batch_input();
             stdin = fopen("/dev/tty", "r");
             batch_mode = 0;
         }
 
-        memset(userInput, 0, sizeof(userInput));
+        if (!batch.map) memset(userInput, 0, sizeof(userInput));
     }
 
     return 0;
 }
 
-int wordEnding(char c) {
-    // You may want to add ';' to this at some point,
-    // or you may want to find a different way to implement chains.
-    return c == '\0' || c == '\n' || isspace(c) || c == ';';
+// A line being split into words. Every place a word could end is found in
+// one pass first (see scan.h), so a word is a jump to the next of those
+// rather than a test of every character in it.
+struct words {
+    const char *line;
+    size_t len;
+    size_t ix; // the next character to look at
+    // Where words could end, in order, then len; ends[next_end] is the
+    // first of them at or after ix.
+    unsigned short ends[MAX_USER_INPUT + 1];
+    size_t next_end;
+};
+
+static void start_words(struct words *w, const char *line, size_t len) {
+    w->line = line;
+    w->len = len;
+    w->ix = 0;
+    w->ends[scan_word_ends(line, len, w->ends)] = len;
+    w->next_end = 0;
+}
+
+// The next word of a command, as a slice of the line: where it starts, and
+// how long it is. A word ends at a space, a ';' or the end of the line, and
+// the command ends at the first of those that isn't preceded by a word, so
+// this returns 0 then. w->ix is left on the character after the word.
+static size_t next_word(struct words *w, const char **word) {
+    while (w->ends[w->next_end] < w->ix) w->next_end++;
+    // skip white spaces, but not the newline that ends the line
+    while (w->ix < w->len && w->ends[w->next_end] == w->ix
+            && w->line[w->ix] != '\n' && w->line[w->ix] != ';') {
+        w->ix++;
+        w->next_end++;
+    }
+    size_t start = w->ix;
+    w->ix = w->ends[w->next_end];
+    *word = w->line + start;
+    return w->ix - start;
 }
 
 int parseInput(const char inp[]) {
-    char tmp[200], *words[100];                            
-    int ix = 0, w = 0;
-    int wordlen;
-    int errorCode = 0;
+    return parse_line(inp, strnlen(inp, MAX_USER_INPUT));
+}
+
+int parse_line(const char inp[], size_t len) {
+    // The words of each command are copied here, NUL-terminated, one after
+    // the other, since the interpreter wants strings it may edit. A word
+    // always ends at a character that isn't copied, so however long the
+    // words are, they and their NULs fit in as much room as the line. Every
+    // command of a chain reuses the same buffer, and nothing is allocated.
+    char text[MAX_USER_INPUT + 1];
+    // Every word takes at least one character and a space, so a line
+    // can't have more than MAX_USER_INPUT / 2 of them.
+    char *words[MAX_USER_INPUT / 2 + 1];
+    // We never look further than this, even if inp is longer.
+    if (len > MAX_USER_INPUT) len = MAX_USER_INPUT;
+    struct words split;
+    start_words(&split, inp, len);
+    int errorCode;
 
     // This function probably isn't the best place to handle chains.
     // That is, if we really wanted to implement relatively complex
@@ -62,48 +194,111 @@ int parseInput(const char inp[]) {
     // interpreter sort it out later.
     // But for this simple shell, the interpreter's job is really only to be
     // command dispatch, and this function is really acting as a complete
-    // parser rather than just a tokenizer. So we'll handle it here.
+    // parser rather than just a tokenizer. So we'll handle it here, one
+    // command of the chain per time around the loop.
+    for (;;) {
+        const char *word;
+        size_t wordlen, text_size = 0;
+        int w = 0;
+        while ((wordlen = next_word(&split, &word)) > 0) {
+            words[w++] = memcpy(text + text_size, word, wordlen);
+            text_size += wordlen;
+            text[text_size++] = '\0';
+        }
+        // In a real shell, we'd really want to ignore lines that don't
+        // contain any instructions. But the spec (particularly the
+        // blanklines test) insists that we instead print an error message.
+        // The "fix" to ignore those lines would be to skip this when w == 0.
+        errorCode = interpreter(words, w, NO_SYMBOL);
 
-    while (inp[ix] != '\n' && inp[ix] != '\0' && ix < 1000) {
-        // skip white spaces
-        for ( ; isspace(inp[ix]) && inp[ix] != '\n' && ix < 1000; ix++);
+        // Only a ';' goes on to the next command; a newline or the end of
+        // the line ends the chain.
+        if (split.ix == len || inp[split.ix] != ';') return errorCode;
+        split.ix++;
+    }
+}
 
-        // If the next character is a semicolon,
-        // we should run what we have so far.
-        if (inp[ix] == ';') break;
+// Script lines used to go through parseInput every time they ran, which
+// meant splitting them up, a strdup for every word, and then a strcmp for
+// every builtin in the interpreter before getting anywhere. None of that
+// changes from one run of the line to the next, so it's done once, when the
+// script is read (see script.h), with tokenize_line, and the result is
+// compiled (see bytecode.h).
 
-        // extract a word
-        for (wordlen = 0; !wordEnding(inp[ix]) && ix < 1000; ix++, wordlen++) {
-            tmp[wordlen] = inp[ix];
-        }
+// The variable a command uses, found the same way the builtins would find
+// it by name: set and print name it, and echo and my_mkdir use it if their
+// word starts with '$'. Whether the command has the right number of words
+// is still up to the builtin; the symbol is only used if it does.
+static size_t instruction_symbol(enum command cmd, int argc, char *argv[]) {
+    if (argc < 2) return NO_SYMBOL;
+    switch (cmd) {
+    case CMD_SET:
+    case CMD_PRINT:
+        return mem_intern(argv[1]);
+    case CMD_ECHO:
+    case CMD_MY_MKDIR:
+        return argv[1][0] == '$' ? mem_intern(argv[1] + 1) : NO_SYMBOL;
+    default:
+        return NO_SYMBOL;
+    }
+}
 
-        if (wordlen > 0) {
-            tmp[wordlen] = '\0';
-            words[w] = strdup(tmp);
-            w++;
-            if (inp[ix] == '\0') break;
-        } else {
-            break;
+struct tokenized_line *tokenize_line(const char *line) {
+    // parseInput never looks further than this.
+    size_t len = strnlen(line, MAX_USER_INPUT - 1);
+    // Each word ends at a space, a ';' or the end of the line, so the words
+    // and their NULs take at most one more byte than the line.
+    char text[MAX_USER_INPUT];
+    size_t text_size = 0;
+    // Every word and every command takes at least one character.
+    size_t word_offsets[MAX_USER_INPUT];
+    struct { int first_word, argc; } commands[MAX_USER_INPUT];
+    int word_count = 0;
+    size_t count = 0;
+    struct words split;
+    start_words(&split, line, len);
+
+    // Exactly as in parseInput: commands are separated by ';', and the
+    // line ends at a newline. An empty command is still a command, since
+    // the interpreter has to complain about it.
+    for (;;) {
+        commands[count].first_word = word_count;
+        commands[count].argc = 0;
+        const char *word;
+        size_t wordlen;
+        while ((wordlen = next_word(&split, &word)) > 0) {
+            word_offsets[word_count++] = text_size;
+            memcpy(text + text_size, word, wordlen);
+            text_size += wordlen;
+            text[text_size++] = '\0';
+            commands[count].argc++;
         }
+        count++;
+        if (split.ix == len || line[split.ix] != ';') break;
+        split.ix++;
     }
-    // In a real shell, we'd really want to ignore lines that don't
-    // contain any instructions. But the spec (particularly the blanklines test)
-    // insists that we instead print an error message.
-    // The "fix" to ignore those lines would be to uncomment this if.
-    //if (w > 0) {
-        errorCode = interpreter(words, w);
-        for (size_t i = 0; i < w; ++i) {
-            free(words[i]);
-        }
-    //}
-    if (inp[ix] == ';') {
-        // handle the next command in the chain by literally recursing
-        // the parser. We could equivalently wrap all of the work above
-        // in a while loop, but this makes it clearer what's going on.
-        // Additionally, a modern compiler is more than smart enough to
-        // turn this into a loop for us! Try adding -O2 to the CFLAGS in
-        // the Makefile and then read the assembly we get.
-        return parseInput(&inp[ix+1]);
+
+    // The instructions, then their words, then the text.
+    size_t instructions_size = count * sizeof(struct instruction);
+    size_t argv_size = word_count * sizeof(char *);
+    struct tokenized_line *tl = malloc(sizeof(struct tokenized_line)
+                                       + instructions_size + argv_size + text_size);
+    tl->count = count;
+    tl->instructions = (struct instruction *)(tl + 1);
+    char **argv = (char **)((char *)tl->instructions + instructions_size);
+    tl->text = (char *)argv + argv_size;
+    tl->text_size = text_size;
+    memcpy(tl->text, text, text_size);
+    for (int w = 0; w < word_count; ++w) {
+        argv[w] = tl->text + word_offsets[w];
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        struct instruction *in = &tl->instructions[i];
+        in->argc = commands[i].argc;
+        in->argv = argv + commands[i].first_word;
+        in->command = in->argc ? command_named(in->argv[0]) : CMD_UNKNOWN;
+        in->symbol = instruction_symbol(in->command, in->argc, in->argv);
     }
-    return errorCode;
+    return tl;
 }
@@ -1,2 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include "command.h"
+
 #define MAX_USER_INPUT 1000
 int parseInput(const char inp[]);
+// The same, for the first len characters of inp, which needn't be followed
+// by a NUL.
+int parse_line(const char inp[], size_t len);
+// In batch mode, main() may read stdin without going through stdio (see
+// shell.c). Anything else that wants to read the rest of stdin must call
+// this first: it leaves stdin just after the last line main() has read,
+// and main() goes back to fgets for the rest.
+void release_batch_input(void);
+
+// A line of script, split into words once, when its script is read, so that running it needn't parse it again. Each command of a ';'
+// chain is one instruction, with the builtin already looked up.
+struct instruction {
+    enum command command;
+    int argc; // the number of words, including the command's name
+    char **argv; // the words, which point into the line's text
+    // The variable the command uses (see shellmemory.h), or NO_SYMBOL.
+    size_t symbol;
+};
+
+struct tokenized_line {
+    size_t count;
+    struct instruction *instructions;
+    // Every word, NUL-terminated, one after the other.
+    char *text;
+    size_t text_size;
+};
+
+// Split the line into instructions the same way parseInput would.
+// Everything is in one allocation, so free() the result when done.
+struct tokenized_line *tokenize_line(const char *line);
@@ -1,7 +1,9 @@
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include "script.h"
 #include "shellmemory.h"
 
 #define true 1
@@ -13,13 +15,23 @@
 
 // We know that program lines will be read, but not modified, until they are
 // removed from the line memory. Therefore, we can provide the line directly
-// to requests, rather than copying it. Freeing a program will free all of its
-// lines.
-// When a line is saved, it should be copied. This way, it can be saved from
-// a stack-allocated buffer without fear of losing it when the buffer is freed.
+// to requests, rather than copying it.
+// Lines used to be copied when they were saved, and freed with their
+// program. Now they belong to the script they came from (see script.h),
+// which is shared by every process running it and kept around by the script
+// cache, so the line memory only borrows them. The PCB holds a reference to
+// the script for as long as its lines are here.
 struct program_line {
     int allocated; // for sanity-checking
-    char *line;
+    const char *line;
+    // Classifying a line is cheap, but not free, and the scheduler wants
+    // to know it for every line of every process. So the script does it
+    // once, when it's read.
+    enum command command;
+    // The same goes for splitting it into words, and resolving the
+    // variables it uses, which used to happen every time it ran; the line
+    // is compiled once, and only the bytecode is run.
+    const struct bytecode *code;
 };
 
 struct program_line linememory[MEM_SIZE];
@@ -33,38 +45,17 @@ struct program_line linememory[MEM_SIZE];
 // the PCB, so we'll do that. This will translate better to having page tables
 // in PCBs in part 3 so it's probably the more sensible approach.
 
-// Therefore, our API is to allocate one line at a time. Normally, we'd have
-// to worry about fragmentation and contiguity, but, we're supposed to allocate
-// everything before anything runs, and everything runs to completion before
-// any more commands can execute, AND there's no recursive run/exec.
-// All of that combined means we don't have to worry about fragmentation
-// at all: between invocations of run/exec, the linememory will be EMPTY!
-//
-// Actually, there is one case of 'recursive' exec: the tests that look like
-//   exec .... #
-//   echo shell
-//   exec ....
-// The 'shell program' will recursively exec. The correct behavior in these
-// cases is to enqueue new program(s), not run them to completion immediately.
-// We're told we can assume that 1000 lines is enough to hold every program
-// that is being tested simultaneously, so we won't worry about the condition
-// that the linememory is empty once exec has been called with #.
-// At that point, the assumption tells us that there is enough memory left.
-
-size_t next_free_line = 0;
-// So we simply record the next free index in a variable.
-// We can't reset this whenever a PCB is freed, because we might be running
-// with # and the shell might be about to allocate another program and that
-// program might not fit in the first hole! So we provide a function to reset
-// this, which should be called whenever `exec` is called and we're not in
-// 'background mode.'
-void reset_linememory_allocator() {
-    next_free_line = 0;
-    assert_linememory_is_empty();
-}
-
-// The comments above detail an important, nontrivial invariant, that the
-// linememory is completely empty at certain times.
+// Originally, our API allocated one line at a time, bumping an index,
+// and reset the index whenever a top-level exec started. That relied on
+// the linememory being EMPTY between invocations of run/exec, and on
+// everything fitting at once. Neither holds any more: a big exec may not
+// fit, and then its processes wait to be admitted (see scheduler.h) until
+// others exit and free their lines. Those holes have to be reused, and the
+// PCB still wants its code contiguous (base+count), so we allocate whole
+// programs at a time instead, first fit.
+// A first-fit scan is O(MEM_SIZE), but MEM_SIZE is small and it only happens
+// once per process, so that's fine.
+
 // For sanity checking, we provide an additional function to assert that the
 // the linememory is empty.
 
@@ -81,30 +72,45 @@ void init_linemem() {
     for (size_t i = 0; i < MEM_SIZE; ++i) {
         linememory[i].allocated = false;
         linememory[i].line = NULL;
+        linememory[i].code = NULL;
     }
 }
 
-size_t allocate_line(const char *line) {
-    if (next_free_line >= MEM_SIZE) {
-        // out of memory!
-        return (size_t)(-1);
+size_t allocate_lines(size_t count) {
+    // run is the length of the hole ending at i.
+    size_t run = 0;
+    for (size_t i = 0; i < MEM_SIZE && run < count; ++i) {
+        run = linememory[i].allocated ? 0 : run + 1;
+        if (run == count) {
+            size_t base = i + 1 - count;
+            for (size_t j = base; j <= i; ++j) {
+                linememory[j].allocated = true;
+            }
+            return base;
+        }
     }
-    size_t index = next_free_line++;
-    assert(!linememory[index].allocated);
+    // out of memory, or at least out of big enough holes!
+    return (size_t)(-1);
+}
 
-    linememory[index].allocated = true;
-    // As described above, the allocator is only borrowing the string passed to it,
-    // but linememory must own all strings it contains, so we need to copy the
-    // string. (If you don't know what that means, see [Note: OBS].)
-    linememory[index].line = strdup(line);
-    return index;
+void store_line(size_t index, const char *line, enum command command,
+                const struct bytecode *code) {
+    assert(linememory[index].allocated);
+    assert(linememory[index].line == NULL);
+    // linememory is only borrowing the line, like the allocator is, so
+    // there's nothing to copy. The script that owns it outlives the line's
+    // stay here. (If you don't know what that means, see [Note: OBS].)
+    linememory[index].line = line;
+    linememory[index].command = command;
+    linememory[index].code = code;
 }
 
-// To free a line, we must deallocate it and adjust next_free.
+// To free a line, we must deallocate it; allocate_lines will find the hole.
+// The line itself goes with its script.
 void free_line(size_t index) {
-    free(linememory[index].line);
     linememory[index].allocated = false;
     linememory[index].line = NULL;
+    linememory[index].code = NULL;
 }
 
 // Return a const pointer to ensure the caller doesn't do something horrific,
@@ -114,6 +120,16 @@ const char *get_line(size_t index) {
     return linememory[index].line;
 }
 
+enum command get_line_command(size_t index) {
+    assert(linememory[index].allocated);
+    return linememory[index].command;
+}
+
+const struct bytecode *get_line_code(size_t index) {
+    assert(linememory[index].allocated);
+    return linememory[index].code;
+}
+
 // [Note: OBS]
 // Thinking about memory in terms of "owners" and "borrowers" was
 // popularized by Rust, and recently formalized by so-called
@@ -128,70 +144,182 @@ const char *get_line(size_t index) {
 // Key-value memory for variables; from part 1.
 // ---------------------
 
-struct memory_struct {
+// This used to be an array of MEM_SIZE pairs that set and get scanned with
+// strcmp, so every print or echo $X cost O(MEM_SIZE), and a store that was
+// full silently dropped new variables. Then it was a hash table from names
+// to values. Now names are interned: the first time a name is seen, whether
+// it's set at the prompt or turns up in a script line being read, it gets
+// the next symbol id, and its value lives at symbols[id]. Reading a script
+// resolves the names in each line to their symbols up front (see
+// tokenize_line in shell.c), so a running script never hashes a name at
+// all; it just indexes the array.
+//
+// The hash table is only needed to turn names into symbols. It's open
+// addressing with Robin Hood probing: a name is stored at the first free
+// slot after its home slot (hash & mask), but on the way it takes the place
+// of any name that is closer to its own home, which then moves on instead.
+// That keeps every name close to home, so a lookup probes a handful of slots
+// and can stop as soon as it meets a name closer to home than the one it's
+// looking for would be. Lines hold on to symbols, so a symbol is never
+// removed (see shellmemory.h), even when its variable is unset; that only
+// clears the value. So nothing is ever deleted from the table either, and
+// there are no tombstones to skip. It starts with room for MEM_SIZE names,
+// and doubles whenever it gets 7/8 full.
+
+struct symbol {
     char *var;
-    char *value;
+    char *value; // NULL if the variable isn't set
 };
 
-struct memory_struct shellmemory[MEM_SIZE];
+struct symbol_slot {
+    size_t symbol; // NO_SYMBOL if the slot is empty
+    // Kept so that probing can skip most strcmps, and growing needn't rehash.
+    uint64_t hash;
+};
+
+static struct symbol *symbols = NULL;
+static size_t symbols_capacity = 0, symbols_count = 0;
+static struct symbol_slot *slots = NULL;
+static size_t slots_capacity = 0;
+
+// FNV-1a. Variable names are short, so this is as fast as anything fancier.
+static uint64_t hash_name(const char *name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *name; ++name) {
+        hash ^= (unsigned char)*name;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// How far slot is past the home slot of a name with this hash.
+static size_t probe_distance(uint64_t hash, size_t slot) {
+    return (slot - hash) & (slots_capacity - 1);
+}
+
+// The symbol for var, or NO_SYMBOL if it was never interned.
+static size_t find_symbol(const char *var, uint64_t hash) {
+    size_t mask = slots_capacity - 1;
+    for (size_t dist = 0, slot = hash & mask; ; ++dist, slot = (slot + 1) & mask) {
+        struct symbol_slot *s = &slots[slot];
+        // Had var been here, it would have displaced s.
+        if (s->symbol == NO_SYMBOL || probe_distance(s->hash, slot) < dist) {
+            return NO_SYMBOL;
+        }
+        if (s->hash == hash && strcmp(symbols[s->symbol].var, var) == 0) {
+            return s->symbol;
+        }
+    }
+}
+
+// Put an entry for a name that isn't in the table yet.
+// There must be a free slot.
+static void insert_slot(struct symbol_slot entry) {
+    size_t mask = slots_capacity - 1;
+    size_t slot = entry.hash & mask, dist = 0;
+    while (slots[slot].symbol != NO_SYMBOL) {
+        size_t other = probe_distance(slots[slot].hash, slot);
+        if (other < dist) {
+            // Robin Hood: the entry further from home gets the slot, and
+            // the one it displaced carries on looking.
+            struct symbol_slot displaced = slots[slot];
+            slots[slot] = entry;
+            entry = displaced;
+            dist = other;
+        }
+        slot = (slot + 1) & mask;
+        dist++;
+    }
+    slots[slot] = entry;
+}
 
-// Helper functions
-int match(char *model, char *var) {
-    int i, len = strlen(var), matchCount = 0;
-    for (i = 0; i < len; i++) {
-        if (model[i] == var[i]) matchCount++;
+static void grow_slots(void) {
+    struct symbol_slot *old = slots;
+    size_t old_capacity = slots_capacity;
+    slots_capacity = old_capacity ? 2 * old_capacity : 16;
+    while (!old_capacity && slots_capacity < MEM_SIZE) slots_capacity *= 2;
+    slots = malloc(slots_capacity * sizeof(struct symbol_slot));
+    for (size_t i = 0; i < slots_capacity; ++i) slots[i].symbol = NO_SYMBOL;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old[i].symbol != NO_SYMBOL) insert_slot(old[i]);
     }
-    if (matchCount == len) {
-        return 1;
-    } else return 0;
+    free(old);
 }
 
 // Shell memory functions
 
 void mem_init(){
-    int i;
-    for (i = 0; i < MEM_SIZE; i++) {		
-        // Include a character that's impossible to type so that
-        // we don't mistake an empty entry for an entry named 'none'.
-        shellmemory[i].var   = "none\1";
-        shellmemory[i].value = "none";
+    for (size_t i = 0; i < symbols_count; ++i) {
+        free(symbols[i].var);
+        free(symbols[i].value);
     }
+    free(symbols);
+    symbols = NULL;
+    symbols_capacity = symbols_count = 0;
+    free(slots);
+    slots = NULL;
+    slots_capacity = 0;
+    grow_slots();
 
+    // Cached scripts are compiled against the symbols we just forgot.
+    script_cache_clear();
     init_linemem();
 }
 
-// Set key value pair
-void mem_set_value(char *var_in, char *value_in) {
-    int i;
-
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, var_in) == 0) {
-            free(shellmemory[i].value);
-            shellmemory[i].value = strdup(value_in);
-            return;
-        } 
-    }
+size_t mem_intern(const char *var) {
+    uint64_t hash = hash_name(var);
+    size_t symbol = find_symbol(var, hash);
+    if (symbol != NO_SYMBOL) return symbol;
 
-    //Value does not exist, need to find a free spot.
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, "none\1") == 0) {
-            shellmemory[i].var   = strdup(var_in);
-            shellmemory[i].value = strdup(value_in);
-            return;
-        } 
+    if (8 * (symbols_count + 1) > 7 * slots_capacity) grow_slots();
+    if (symbols_count == symbols_capacity) {
+        symbols_capacity = symbols_capacity ? 2 * symbols_capacity : MEM_SIZE;
+        symbols = realloc(symbols, symbols_capacity * sizeof(struct symbol));
     }
+    symbol = symbols_count++;
+    symbols[symbol].var = strdup(var);
+    symbols[symbol].value = NULL;
+    struct symbol_slot entry = { symbol, hash };
+    insert_slot(entry);
+    return symbol;
+}
+
+const char *mem_view_symbol(size_t symbol) {
+    assert(symbol < symbols_count);
+    // Growing the array moves the symbols, but not the strings they point
+    // to, so only changing or unsetting this variable invalidates the view.
+    return symbols[symbol].value;
+}
+
+void mem_set_symbol(size_t symbol, const char *value) {
+    assert(symbol < symbols_count);
+    free(symbols[symbol].value);
+    symbols[symbol].value = strdup(value);
+}
 
-    return;
+// Set key value pair
+void mem_set_value(char *var_in, char *value_in) {
+    mem_set_symbol(mem_intern(var_in), value_in);
 }
 
 //get value based on input key
 char *mem_get_value(char *var_in) {
-    int i;
+    const char *value = mem_view_value(var_in);
+    return value ? strdup(value) : NULL;
+}
 
-    for (i = 0; i < MEM_SIZE; i++) {
-        if (strcmp(shellmemory[i].var, var_in) == 0){
-            return strdup(shellmemory[i].value);
-        } 
-    }
-    return NULL;
-}
\ No newline at end of file
+const char *mem_view_value(const char *var_in) {
+    // Only look the name up: reading a variable that was never set
+    // shouldn't intern it.
+    size_t symbol = find_symbol(var_in, hash_name(var_in));
+    if (symbol == NO_SYMBOL) return NULL;
+    return symbols[symbol].value;
+}
+
+int mem_unset_value(char *var_in) {
+    size_t symbol = find_symbol(var_in, hash_name(var_in));
+    if (symbol == NO_SYMBOL || !symbols[symbol].value) return 1;
+    free(symbols[symbol].value);
+    symbols[symbol].value = NULL;
+    return 0;
+}
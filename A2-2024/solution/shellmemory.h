@@ -1,11 +1,54 @@
+#include <stddef.h>
+#include "command.h"
+
 #define MEM_SIZE 1000
 
 void assert_linememory_is_empty(void);
-size_t allocate_line(const char *line);
+// Reserve count contiguous lines. Returns the index of the first one,
+// or (size_t)-1 if there's no hole big enough.
+size_t allocate_lines(size_t count);
+// Store line at index, which allocate_lines reserved, along with the
+// builtin it starts with and its compiled code. None of them are copied:
+// they must stay put until free_line (see script.h).
+struct bytecode;
+void store_line(size_t index, const char *line, enum command command,
+                const struct bytecode *code);
 void free_line(size_t index);
 const char *get_line(size_t index);
-void reset_linememory_allocator(void);
+// The builtin the line at index starts with, worked out when it was read.
+enum command get_line_command(size_t index);
+// The line at index, compiled (see bytecode.h) and ready to run.
+const struct bytecode *get_line_code(size_t index);
 
+// The variables are kept in a hash table (see shellmemory.c), so these are
+// all O(1) however many there are. MEM_SIZE is only the initial capacity.
+// mem_init also clears any variables that were set, and forgets every
+// symbol, so it must not be called while there are lines in line memory.
+// It empties the script cache, too.
 void mem_init();
+// A malloc'd copy of the variable's value, or NULL if it isn't set.
 char *mem_get_value(char *var);
+// The variable's value itself, or NULL if it isn't set. Nothing is copied,
+// so this is what the builtins use. The view is only good until the next
+// mem_set_value, mem_unset_value or mem_init, any of which may free it;
+// copy it (or use mem_get_value) to keep it for longer.
+const char *mem_view_value(const char *var);
 void mem_set_value(char *var, char *value);
+// Clear the variable. Its symbol stays (see below), so only the value goes.
+// Returns 0 if it was set, non-zero if it wasn't.
+int mem_unset_value(char *var);
+
+// Every variable name is interned as a symbol: a small id, counting up from
+// 0, that stays the same for as long as the shell runs. Script lines are
+// resolved to symbols when they are read (see get_line_code), so running
+// them needn't hash or compare any names.
+// Symbols are never freed, except all at once by mem_init: compiled code in
+// the script cache and in line memory holds symbols without counting them,
+// so there's no telling when a name is no longer used. The cost is one name
+// per distinct variable the shell has ever seen.
+#define NO_SYMBOL ((size_t)(-1))
+// The symbol for the variable name, interning it if it's new.
+size_t mem_intern(const char *var);
+// The same as mem_view_value and mem_set_value, given the symbol.
+const char *mem_view_symbol(size_t symbol);
+void mem_set_symbol(size_t symbol, const char *value);
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#include <time.h> // clock_gettime
+
+// Nanoseconds on CLOCK_MONOTONIC. This is served from the vDSO on Linux,
+// so it costs tens of nanoseconds and never goes backwards.
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,161 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "trace.h"
+
+struct trace_record {
+    uint64_t ts;
+    uint32_t pid;
+    uint32_t kind;
+    char name[16];
+};
+
+// One thread's events. Only the owning thread writes to it; it's read once,
+// at exit, when nothing is being recorded any more.
+struct trace_ring {
+    struct trace_record records[TRACE_RING_SIZE];
+    // Events ever recorded; the newest is at (written - 1) % TRACE_RING_SIZE.
+    size_t written;
+    // Shows up as the trace's "pid", to tell the threads apart.
+    int thread_index;
+    struct trace_ring *next;
+};
+
+static int trace_enabled = 0;
+static const char *trace_path = NULL;
+// Every thread's ring, newest first. Threads push themselves on with a
+// compare-and-swap the first time they record something; nothing is
+// ever removed.
+static _Atomic(struct trace_ring *) rings = NULL;
+static atomic_int threads_seen = 0;
+static _Thread_local struct trace_ring *my_ring = NULL;
+
+static struct trace_ring *register_ring(void) {
+    struct trace_ring *ring = malloc(sizeof(struct trace_ring));
+    if (!ring) return NULL;
+    ring->written = 0;
+    ring->thread_index = atomic_fetch_add(&threads_seen, 1) + 1;
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {
+        // ring->next was updated to the current head; try again.
+    }
+    return ring;
+}
+
+void trace_event(enum trace_event_kind kind, size_t pid, const char *name) {
+    if (!trace_enabled) return;
+    if (!my_ring && !(my_ring = register_ring())) return;
+
+    struct trace_record *r = &my_ring->records[my_ring->written % TRACE_RING_SIZE];
+    r->ts = monotonic_ns();
+    r->pid = (uint32_t)pid;
+    r->kind = kind;
+    if (name) {
+        strncpy(r->name, name, sizeof(r->name) - 1);
+        r->name[sizeof(r->name) - 1] = '\0';
+    } else {
+        r->name[0] = '\0';
+    }
+    my_ring->written++;
+}
+
+// ---------------------
+// Writing the trace out. See the "Trace Event Format" document for the
+// format; we use B/E pairs for slices and "i" for instants. Timestamps are
+// in microseconds, so we print the nanoseconds with a decimal point.
+// ---------------------
+
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20)         fprintf(out, "\\u%04x", c);
+        else                       fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_event_head(FILE *out, int *first, const char *ph,
+                             int thread, const struct trace_record *r) {
+    fprintf(out, "%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":%llu.%03llu",
+            *first ? "" : ",", ph, thread, r->pid,
+            (unsigned long long)(r->ts / 1000),
+            (unsigned long long)(r->ts % 1000));
+    *first = 0;
+}
+
+static void write_instant(FILE *out, int *first, int thread,
+                          const struct trace_record *r, const char *what) {
+    write_event_head(out, first, "i", thread, r);
+    fprintf(out, ",\"s\":\"t\",\"name\":\"%s\"}", what);
+}
+
+static void write_ring(FILE *out, int *first, struct trace_ring *ring) {
+    fprintf(out, "%s\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\","
+                 "\"args\":{\"name\":\"mysh thread %d\"}}",
+            *first ? "" : ",", ring->thread_index, ring->thread_index);
+    *first = 0;
+
+    size_t kept = ring->written < TRACE_RING_SIZE ? ring->written : TRACE_RING_SIZE;
+    // If the ring wrapped, it may start in the middle of a slice. Ends of
+    // slices we never saw the start of would only confuse the viewer.
+    int seen_dispatch = 0;
+    for (size_t i = ring->written - kept; i < ring->written; ++i) {
+        const struct trace_record *r = &ring->records[i % TRACE_RING_SIZE];
+        int thread = ring->thread_index;
+        switch (r->kind) {
+        case TRACE_DISPATCH:
+            seen_dispatch = 1;
+            write_event_head(out, first, "B", thread, r);
+            fprintf(out, ",\"name\":");
+            write_json_string(out, r->name);
+            fputc('}', out);
+            break;
+        case TRACE_PREEMPT:
+            if (!seen_dispatch) break;
+            write_event_head(out, first, "E", thread, r);
+            fputc('}', out);
+            break;
+        case TRACE_EXIT:
+            if (seen_dispatch) {
+                write_event_head(out, first, "E", thread, r);
+                fputc('}', out);
+            }
+            write_instant(out, first, thread, r, "exit");
+            break;
+        case TRACE_PAGE_FAULT:
+            write_instant(out, first, thread, r, "page fault");
+            break;
+        case TRACE_BLOCK:
+            write_instant(out, first, thread, r, "blocked");
+            break;
+        }
+    }
+}
+
+static void trace_dump(void) {
+    trace_enabled = 0;
+    FILE *out = fopen(trace_path, "w");
+    if (!out) {
+        perror("failed to open MYSH_TRACE file");
+        return;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    int first = 1;
+    for (struct trace_ring *ring = atomic_load(&rings); ring; ring = ring->next) {
+        write_ring(out, &first, ring);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+void trace_init(void) {
+    trace_path = getenv("MYSH_TRACE");
+    if (!trace_path || !*trace_path) return;
+    trace_enabled = 1;
+    atexit(trace_dump);
+}
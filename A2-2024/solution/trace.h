@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+
+// A timeline of what the scheduler did, for looking at in Perfetto
+// (ui.perfetto.dev) or chrome://tracing, rather than guessing from the
+// order that echo output came out in.
+//
+// Tracing is off unless the MYSH_TRACE environment variable names a file.
+// Then every event is stamped with monotonic_ns() and appended to a ring
+// buffer belonging to the thread that recorded it, and when the shell exits
+// the buffers are written to that file in the Chrome trace-event format.
+// Each process gets its own track (its pid is the trace's "tid"), with a
+// slice for every time it was dispatched.
+//
+// Recording an event is a clock read and a store into a buffer that only
+// its own thread writes to, so there are no locks, and tracing is cheap
+// enough to leave on. When a ring is full, the oldest events are dropped.
+
+enum trace_event_kind {
+    TRACE_DISPATCH,   // the process starts a slice
+    TRACE_PREEMPT,    // the slice ended before the process finished
+    TRACE_PAGE_FAULT, // the process needed code that wasn't in memory
+    TRACE_BLOCK,      // the process can't run until something happens:
+                      // until there's room for it in shellmemory, or until
+                      // the job it waits for exits. A wait in a slice ends
+                      // the slice first, with a TRACE_PREEMPT.
+    TRACE_EXIT,       // the slice ended because the process finished
+};
+
+// Events each thread keeps. A power of two.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE (1 << 15)
+#endif
+
+// Turn tracing on if MYSH_TRACE is set. Call once, from main.
+void trace_init(void);
+
+// Record an event for the process with this pid. name is only used for
+// TRACE_DISPATCH, to label the slice, and is copied (up to 15 characters),
+// so it doesn't need to outlive the call. Does nothing if tracing is off.
+void trace_event(enum trace_event_kind kind, size_t pid, const char *name);